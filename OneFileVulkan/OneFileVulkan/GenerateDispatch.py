@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Regenerates the dispatch table X-macros in OneFileVulkan.cpp from the bundled vulkan_core.h
+# Usage, from this directory: python GenerateDispatch.py
+#
+# Every PFN_vk* typedef of vulkan_core.h is sorted by the handle of its first parameter:
+#	global   - vkCreateInstance and the vkEnumerateInstance* functions, loaded with a null instance
+#	device   - first parameter is a VkDevice, VkQueue or VkCommandBuffer, loaded with vkGetDeviceProcAddr
+#	instance - everything else, loaded with vkGetInstanceProcAddr
+# Functions of VK_VERSION_1_0 are REQUIRED, the loader aborts when one is missing.
+# Newer core versions and extensions are OPTIONAL and stay null when unavailable or not enabled.
+
+import re
+import sys
+
+HEADER = "include/vulkan/vulkan_core.h"
+SOURCE = "OneFileVulkan.cpp"
+BEGIN = "//BEGIN GENERATED DISPATCH"
+END = "//END GENERATED DISPATCH"
+
+GLOBAL_FUNCTIONS = {"vkCreateInstance", "vkEnumerateInstanceExtensionProperties", "vkEnumerateInstanceLayerProperties", "vkEnumerateInstanceVersion"}
+DEVICE_HANDLES = {"VkDevice", "VkQueue", "VkCommandBuffer"}
+#vkGetInstanceProcAddr is loaded once, by hand, to bootstrap everything else
+#vkVoidFunction is the type vkGet*ProcAddr return, not an entry point
+SKIPPED_FUNCTIONS = {"vkGetInstanceProcAddr", "vkVoidFunction"}
+
+feature_re = re.compile(r"^#define (VK_[A-Za-z0-9_]+) 1$")
+pfn_re = re.compile(r"^typedef .*\(VKAPI_PTR \*PFN_(vk\w+)\)\((\w+)")
+version_re = re.compile(r"^#define VK_HEADER_VERSION (\d+)")
+
+
+def main():
+    groups = {"GLOBAL": [], "INSTANCE": [], "DEVICE": []}
+    feature = None
+    header_version = "?"
+
+    with open(HEADER) as header:
+        for line in header:
+            line = line.rstrip()
+            m = version_re.match(line)
+            if m:
+                header_version = m.group(1)
+            m = feature_re.match(line)
+            if m and (m.group(1).startswith("VK_VERSION_") or re.match(r"VK_[A-Z0-9]+_[a-z]", m.group(1))):
+                feature = m.group(1)
+                continue
+            m = pfn_re.match(line)
+            if not m or m.group(1) in SKIPPED_FUNCTIONS:
+                continue
+            name, first_parameter = m.groups()
+            kind = "REQUIRED" if feature == "VK_VERSION_1_0" else "OPTIONAL"
+            if name in GLOBAL_FUNCTIONS:
+                groups["GLOBAL"].append((kind, name))
+            elif first_parameter in DEVICE_HANDLES and name != "vkGetDeviceProcAddr":
+                groups["DEVICE"].append((kind, name))
+            else:
+                groups["INSTANCE"].append((kind, name))
+
+    lines = [BEGIN + " - GenerateDispatch.py, vulkan_core.h VK_HEADER_VERSION " + header_version]
+    for group, functions in groups.items():
+        lines.append("#define VK_%s_FUNCTIONS(REQUIRED, OPTIONAL) \\" % group)
+        lines += ["\t%s(%s) \\" % function for function in functions]
+        lines.append("")
+    lines.append(END)
+
+    with open(SOURCE, newline="") as source:
+        text = source.read()
+    newline = "\r\n" if "\r\n" in text else "\n"
+    begin = text.index(BEGIN)
+    end = text.index(END) + len(END)
+    text = text[:begin] + newline.join(lines) + text[end:]
+    with open(SOURCE, "w", newline="") as source:
+        source.write(text)
+
+    print("%d global, %d instance, %d device functions" % tuple(len(f) for f in groups.values()))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,236 @@
+#!/usr/bin/env python3
+# Assembles the SPIR-V assembly shaders of shaders/ and embeds them in OneFileVulkan.cpp
+# Usage, from this directory: python GenerateShaders.py
+# Needs nothing but Python, the assembler below covers the instructions and enumerants the shaders use.
+#
+# Each shaders/<name>.<stage>.spvasm becomes an array named after the file, overlay.frag.spvasm is overlayFrag, and
+# an entry of the SHADER_BINARIES X-macro. The shader registry builds its table and the compile-time keys from that
+# macro, so the program never reads or parses a shader file at run time.
+#
+# The syntax is the one of spirv-as and spirv-dis: one instruction per line, "%result = OpName operands", ';' starts a
+# comment. %<number> is that id, any other %name gets the next free id after the numbered ones. Literals are
+# integers, floats for OpConstant of a float type, "strings" and enumerant names. Each file starts with the GLSL it
+# implements as comments.
+
+import os
+import re
+import struct
+import sys
+
+SHADERS = "shaders"
+SOURCE = "OneFileVulkan.cpp"
+BEGIN = "//BEGIN GENERATED SHADERS"
+END = "//END GENERATED SHADERS"
+EXTENSION = ".spvasm"
+STAGES = {"vert", "frag", "comp"}
+WORDS_PER_LINE = 8
+
+SPIRV_MAGIC = 0x07230203
+SPIRV_VERSION = 0x00010000 #1.0, what Vulkan 1.0 consumes
+SPIRV_GENERATOR = 0 #no registered generator
+
+ENUMERANTS = {
+    "Capability": {"Matrix": 0, "Shader": 1},
+    "AddressingModel": {"Logical": 0},
+    "MemoryModel": {"Simple": 0, "GLSL450": 1},
+    "ExecutionModel": {"Vertex": 0, "Fragment": 4, "GLCompute": 5},
+    "ExecutionMode": {"OriginUpperLeft": 7, "LocalSize": 17},
+    "StorageClass": {"UniformConstant": 0, "Input": 1, "Uniform": 2, "Output": 3, "Private": 6, "Function": 7, "PushConstant": 9, "Image": 11},
+    "Decoration": {"Block": 2, "ColMajor": 5, "NoPerspective": 13, "Flat": 14, "NonWritable": 24, "NonReadable": 25, "BuiltIn": 11, "Location": 30, "Binding": 33, "DescriptorSet": 34, "Offset": 35},
+    "BuiltIn": {"Position": 0, "PointSize": 1, "VertexIndex": 42, "InstanceIndex": 43, "FragCoord": 15, "LocalInvocationId": 27, "GlobalInvocationId": 28},
+    "Dim": {"1D": 0, "2D": 1, "3D": 2, "Cube": 3},
+    "ImageFormat": {"Unknown": 0, "Rgba32f": 1, "Rgba16f": 2, "Rgba8": 4},
+    "FunctionControl": {"None": 0, "Inline": 1, "DontInline": 2},
+    "SelectionControl": {"None": 0, "Flatten": 1, "DontFlatten": 2},
+    "LoopControl": {"None": 0, "Unroll": 1, "DontUnroll": 2},
+    "MemoryAccess": {"None": 0, "Volatile": 1, "Aligned": 2},
+    "ImageOperands": {"None": 0, "Bias": 1, "Lod": 2},
+}
+
+# Operand kinds: type (result type id), result, id, literal, string, an ENUMERANTS kind, constant (literal of the
+# result type), decoration (a Decoration and its literals), and a trailing "*" for any number of the kind
+OPCODES = {
+    "OpCapability": (17, ["Capability"]),
+    "OpMemoryModel": (14, ["AddressingModel", "MemoryModel"]),
+    "OpEntryPoint": (15, ["ExecutionModel", "id", "string", "id*"]),
+    "OpExecutionMode": (16, ["id", "ExecutionMode", "literal*"]),
+    "OpDecorate": (71, ["id", "decoration"]),
+    "OpMemberDecorate": (72, ["id", "literal", "decoration"]),
+    "OpTypeVoid": (19, ["result"]),
+    "OpTypeBool": (20, ["result"]),
+    "OpTypeInt": (21, ["result", "literal", "literal"]),
+    "OpTypeFloat": (22, ["result", "literal"]),
+    "OpTypeVector": (23, ["result", "id", "literal"]),
+    "OpTypeImage": (25, ["result", "id", "Dim", "literal", "literal", "literal", "literal", "ImageFormat"]),
+    "OpTypeSampledImage": (27, ["result", "id"]),
+    "OpTypeStruct": (30, ["result", "id*"]),
+    "OpTypePointer": (32, ["result", "StorageClass", "id"]),
+    "OpTypeFunction": (33, ["result", "id", "id*"]),
+    "OpConstant": (43, ["type", "result", "constant"]),
+    "OpConstantComposite": (44, ["type", "result", "id*"]),
+    "OpFunction": (54, ["type", "result", "FunctionControl", "id"]),
+    "OpFunctionEnd": (56, []),
+    "OpVariable": (59, ["type", "result", "StorageClass", "id*"]),
+    "OpLoad": (61, ["type", "result", "id", "MemoryAccess*"]),
+    "OpStore": (62, ["id", "id", "MemoryAccess*"]),
+    "OpAccessChain": (65, ["type", "result", "id", "id*"]),
+    "OpVectorShuffle": (79, ["type", "result", "id", "id", "literal*"]),
+    "OpCompositeConstruct": (80, ["type", "result", "id*"]),
+    "OpCompositeExtract": (81, ["type", "result", "id", "literal*"]),
+    "OpCompositeInsert": (82, ["type", "result", "id", "id", "literal*"]),
+    "OpImageSampleImplicitLod": (87, ["type", "result", "id", "id", "ImageOperands*"]),
+    "OpImageWrite": (99, ["id", "id", "id", "ImageOperands*"]),
+    "OpBitcast": (124, ["type", "result", "id"]),
+    "OpIAdd": (128, ["type", "result", "id", "id"]),
+    "OpFAdd": (129, ["type", "result", "id", "id"]),
+    "OpFMul": (133, ["type", "result", "id", "id"]),
+    "OpAny": (154, ["type", "result", "id"]),
+    "OpAll": (155, ["type", "result", "id"]),
+    "OpULessThan": (176, ["type", "result", "id", "id"]),
+    "OpSelectionMerge": (247, ["id", "SelectionControl"]),
+    "OpLabel": (248, ["result"]),
+    "OpBranch": (249, ["id"]),
+    "OpBranchConditional": (250, ["id", "id", "id", "literal*"]),
+    "OpReturn": (253, []),
+}
+
+# Decorations followed by an enumerant rather than literals
+DECORATION_OPERANDS = {"BuiltIn": "BuiltIn"}
+
+token_re = re.compile(r'"(?:[^"\\]|\\.)*"|[^\s"]+')
+
+
+def array_name(filename):
+    stem, stage = filename[:-len(EXTENSION)].rsplit(".", 1)
+    return stem + stage.capitalize()
+
+
+def string_words(text):
+    data = text.encode("utf-8") + b"\0"
+    data += b"\0" * (-len(data) % 4)
+    return list(struct.unpack("<%dI" % (len(data) // 4), data))
+
+
+def enumerant(kind, token, where):
+    if token.isdigit():
+        return int(token)
+    if token not in ENUMERANTS[kind]:
+        sys.exit("%s: unknown %s %s" % (where, kind, token))
+    return ENUMERANTS[kind][token]
+
+
+def assemble(path):
+    with open(path) as source:
+        lines = [(number, token_re.findall(line.split(";", 1)[0])) for number, line in enumerate(source, 1)]
+    lines = [(number, tokens) for number, tokens in lines if tokens]
+
+    # Numbered ids keep their number, named ones follow in order of appearance
+    ids = {}
+    for number, tokens in lines:
+        for token in tokens:
+            if token.startswith("%") and token[1:].isdigit():
+                ids[token] = int(token[1:])
+    bound = max(ids.values(), default=0) + 1
+    for number, tokens in lines:
+        for token in tokens:
+            if token.startswith("%") and token not in ids:
+                ids[token] = bound
+                bound += 1
+
+    types = {} # id of each scalar type, to encode OpConstant literals
+    words = [SPIRV_MAGIC, SPIRV_VERSION, SPIRV_GENERATOR, bound, 0]
+    for number, tokens in lines:
+        where = "%s:%d" % (path, number)
+        result = None
+        if len(tokens) > 2 and tokens[1] == "=":
+            result, tokens = tokens[0], tokens[2:]
+        name, operands = tokens[0], tokens[1:]
+        if name not in OPCODES:
+            sys.exit("%s: unknown instruction %s" % (where, name))
+        opcode, kinds = OPCODES[name]
+
+        instruction = []
+        resultType = None
+        for kind in kinds:
+            repeated = kind.endswith("*")
+            kind = kind.rstrip("*")
+            while True:
+                if kind == "result":
+                    if result is None:
+                        sys.exit("%s: %s needs a result" % (where, name))
+                    instruction.append(ids[result])
+                    break
+                if not operands:
+                    if repeated:
+                        break
+                    sys.exit("%s: %s is missing operands" % (where, name))
+                token = operands.pop(0)
+                if kind == "type":
+                    resultType = token
+                    instruction.append(ids[token])
+                elif kind == "id":
+                    instruction.append(ids[token])
+                elif kind == "literal":
+                    instruction.append(int(token, 0))
+                elif kind == "string":
+                    instruction += string_words(token[1:-1])
+                elif kind == "constant":
+                    if types.get(resultType) == "float":
+                        instruction.append(struct.unpack("<I", struct.pack("<f", float(token)))[0])
+                    else:
+                        instruction.append(int(token, 0) & 0xFFFFFFFF)
+                elif kind == "decoration":
+                    instruction.append(enumerant("Decoration", token, where))
+                    extra = DECORATION_OPERANDS.get(token)
+                    while operands:
+                        instruction.append(enumerant(extra, operands.pop(0), where) if extra else int(operands.pop(0), 0))
+                else:
+                    instruction.append(enumerant(kind, token, where))
+                if not repeated:
+                    break
+        if operands:
+            sys.exit("%s: too many operands for %s" % (where, name))
+
+        if name == "OpTypeFloat":
+            types[result] = "float"
+        elif name == "OpTypeInt":
+            types[result] = "int"
+        words.append((len(instruction) + 1) << 16 | opcode)
+        words += instruction
+    return words
+
+
+def embed(filename, words):
+    lines = ["//%s/%s" % (SHADERS, filename), "alignas(64) constexpr uint32_t %s[] = {" % array_name(filename)]
+    for i in range(0, len(words), WORDS_PER_LINE):
+        lines.append("\t" + " ".join("0x%08x," % word for word in words[i:i + WORDS_PER_LINE]))
+    lines.append("};")
+    lines.append("")
+    return lines
+
+
+def main():
+    filenames = sorted(f for f in os.listdir(SHADERS) if f.endswith(EXTENSION) and f[:-len(EXTENSION)].rsplit(".", 1)[-1] in STAGES)
+
+    lines = [BEGIN + " - GenerateShaders.py"]
+    for filename in filenames:
+        lines += embed(filename, assemble(os.path.join(SHADERS, filename)))
+    lines.append("#define SHADER_BINARIES(X) \\")
+    lines += ["\tX(\"%s\", %s) \\" % (filename[:-len(EXTENSION)], array_name(filename)) for filename in filenames]
+    lines.append("")
+    lines.append(END)
+
+    with open(SOURCE, newline="") as source:
+        text = source.read()
+    newline = "\r\n" if "\r\n" in text else "\n"
+    begin = text.index(BEGIN)
+    end = text.index(END) + len(END)
+    text = text[:begin] + newline.join(lines) + text[end:]
+    with open(SOURCE, "w", newline="") as source:
+        source.write(text)
+
+    print("%d shaders" % len(filenames))
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,25 +1,88 @@
+#ifdef _MSC_VER
 #pragma warning(disable : 26812)
+#endif
 
+#ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
 #define VK_USE_PLATFORM_WIN32_KHR
+#define PLATFORM_SURFACE_EXTENSION_NAME VK_KHR_WIN32_SURFACE_EXTENSION_NAME
+#else
+#define VK_USE_PLATFORM_XCB_KHR
+#define PLATFORM_SURFACE_EXTENSION_NAME VK_KHR_XCB_SURFACE_EXTENSION_NAME
+#endif
 #define VK_NO_PROTOTYPES
 #include "vulkan.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
 #include <iostream>
-#include <tchar.h>
+#include <mutex>
+#include <string>
+#include <thread>
 #include <vector>
 
+#ifdef _WIN32
+#include <intrin.h>
+#include <psapi.h>
+#include <tchar.h>
+#else
+#include <dlfcn.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <time.h>
+
+//The Linux build is narrow characters only
+typedef char TCHAR;
+typedef const char* LPCTSTR;
+#define TEXT(s) s
+#define ExitProcess(code) exit(static_cast<int>(code))
+
+//snprintf returns the length it would have written, truncated text returns what fits instead, so callers adding up
+//lengths to pass size - length on always stay inside the buffer
+__attribute__((format(printf, 3, 4))) inline int _stprintf_s(char* buffer, size_t size, const char* format, ...)
+{
+	va_list arguments;
+	va_start(arguments, format);
+	int length = vsnprintf(buffer, size, format, arguments);
+	va_end(arguments);
+	if(length >= 0 && static_cast<size_t>(length) >= size)
+		return size ? static_cast<int>(size - 1) : 0;
+	return length;
+}
+#endif
+
 #ifdef UNICODE
+#define TCOUT std::wcout
 #define TCERR std::wcerr
+#define TOFSTREAM std::wofstream
 #else
+#define TCOUT std::cout
 #define TCERR std::cerr
+#define TOFSTREAM std::ofstream
 #endif
 
-__declspec(noreturn) void Abort(LPCTSTR message);
-__declspec(noreturn) void Win32Abort(LPCTSTR message);
-__declspec(noreturn) void VkAbort(VkResult result, LPCTSTR fn);
+[[noreturn]] void Abort(LPCTSTR message);
+#ifdef _WIN32
+[[noreturn]] void Win32Abort(LPCTSTR message);
+#else
+[[noreturn]] void DlAbort(LPCTSTR message);
+#endif
+[[noreturn]] void VkAbort(VkResult result, LPCTSTR fn);
 
 #define APPLICATION_NAME "OneFileVulkan"
+#define MAX_FRAMES_IN_FLIGHT 3
 
 #ifdef NDEBUG
 #define ASSERT(fn)
@@ -42,72 +105,4447 @@ __declspec(noreturn) void VkAbort(VkResult result, LPCTSTR fn);
 	}
 #endif
 
+#ifdef _WIN32
 #define VK_LOAD_FROM_MODULE(hmodule, fn) \
 	PFN_##fn fn = (PFN_##fn)GetProcAddress(hmodule, #fn); \
 	if(!fn) \
 	Win32Abort(TEXT("GetProcAddress failed for " #fn))
-
-#define VK_LOAD_FROM_VULKAN(fn) \
-	PFN_##fn fn = (PFN_##fn)vkGetInstanceProcAddr(nullptr, #fn); \
+#else
+#define VK_LOAD_FROM_MODULE(hmodule, fn) \
+	PFN_##fn fn = (PFN_##fn)dlsym(hmodule, #fn); \
 	if(!fn) \
-	Abort(TEXT("vkGetInstanceProcAddr failed for " #fn))
+	DlAbort(TEXT("dlsym failed for " #fn))
+#endif
 
 #define VK_LOAD_FROM_VULKAN_INSTANCE(instance, fn) \
 	PFN_##fn fn = (PFN_##fn)vkGetInstanceProcAddr(instance, #fn); \
 	if(!fn) \
 	Abort(TEXT("vkGetInstanceProcAddr failed for " #fn))
 
-#define VK_LOAD_FROM_VULKAN_DEVICE(device, fn) \
-	PFN_##fn fn = (PFN_##fn)vkGetDeviceProcAddr(device, #fn); \
-	if(!fn) \
-	Abort(TEXT("vkGetDeviceProcAddr failed for " #fn))
+//Dispatch tables
+//The function lists are generated from the bundled vulkan_core.h, run GenerateDispatch.py after updating it.
+//Device level functions are loaded with vkGetDeviceProcAddr and call straight into the driver,
+//instead of going through the loader trampoline that dispatches on the handle at every call.
+//Platform surface functions live outside of vulkan_core.h and are loaded where used with VK_LOAD_FROM_VULKAN_INSTANCE.
+//BEGIN GENERATED DISPATCH - GenerateDispatch.py, vulkan_core.h VK_HEADER_VERSION 174
+#define VK_GLOBAL_FUNCTIONS(REQUIRED, OPTIONAL) \
+	REQUIRED(vkCreateInstance) \
+	REQUIRED(vkEnumerateInstanceExtensionProperties) \
+	REQUIRED(vkEnumerateInstanceLayerProperties) \
+	OPTIONAL(vkEnumerateInstanceVersion) \
+
+#define VK_INSTANCE_FUNCTIONS(REQUIRED, OPTIONAL) \
+	REQUIRED(vkDestroyInstance) \
+	REQUIRED(vkEnumeratePhysicalDevices) \
+	REQUIRED(vkGetPhysicalDeviceFeatures) \
+	REQUIRED(vkGetPhysicalDeviceFormatProperties) \
+	REQUIRED(vkGetPhysicalDeviceImageFormatProperties) \
+	REQUIRED(vkGetPhysicalDeviceProperties) \
+	REQUIRED(vkGetPhysicalDeviceQueueFamilyProperties) \
+	REQUIRED(vkGetPhysicalDeviceMemoryProperties) \
+	REQUIRED(vkGetDeviceProcAddr) \
+	REQUIRED(vkCreateDevice) \
+	REQUIRED(vkEnumerateDeviceExtensionProperties) \
+	REQUIRED(vkEnumerateDeviceLayerProperties) \
+	REQUIRED(vkGetPhysicalDeviceSparseImageFormatProperties) \
+	OPTIONAL(vkEnumeratePhysicalDeviceGroups) \
+	OPTIONAL(vkGetPhysicalDeviceFeatures2) \
+	OPTIONAL(vkGetPhysicalDeviceProperties2) \
+	OPTIONAL(vkGetPhysicalDeviceFormatProperties2) \
+	OPTIONAL(vkGetPhysicalDeviceImageFormatProperties2) \
+	OPTIONAL(vkGetPhysicalDeviceQueueFamilyProperties2) \
+	OPTIONAL(vkGetPhysicalDeviceMemoryProperties2) \
+	OPTIONAL(vkGetPhysicalDeviceSparseImageFormatProperties2) \
+	OPTIONAL(vkGetPhysicalDeviceExternalBufferProperties) \
+	OPTIONAL(vkGetPhysicalDeviceExternalFenceProperties) \
+	OPTIONAL(vkGetPhysicalDeviceExternalSemaphoreProperties) \
+	OPTIONAL(vkDestroySurfaceKHR) \
+	OPTIONAL(vkGetPhysicalDeviceSurfaceSupportKHR) \
+	OPTIONAL(vkGetPhysicalDeviceSurfaceCapabilitiesKHR) \
+	OPTIONAL(vkGetPhysicalDeviceSurfaceFormatsKHR) \
+	OPTIONAL(vkGetPhysicalDeviceSurfacePresentModesKHR) \
+	OPTIONAL(vkGetPhysicalDevicePresentRectanglesKHR) \
+	OPTIONAL(vkGetPhysicalDeviceDisplayPropertiesKHR) \
+	OPTIONAL(vkGetPhysicalDeviceDisplayPlanePropertiesKHR) \
+	OPTIONAL(vkGetDisplayPlaneSupportedDisplaysKHR) \
+	OPTIONAL(vkGetDisplayModePropertiesKHR) \
+	OPTIONAL(vkCreateDisplayModeKHR) \
+	OPTIONAL(vkGetDisplayPlaneCapabilitiesKHR) \
+	OPTIONAL(vkCreateDisplayPlaneSurfaceKHR) \
+	OPTIONAL(vkGetPhysicalDeviceFeatures2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceProperties2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceFormatProperties2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceImageFormatProperties2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceQueueFamilyProperties2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceMemoryProperties2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceSparseImageFormatProperties2KHR) \
+	OPTIONAL(vkEnumeratePhysicalDeviceGroupsKHR) \
+	OPTIONAL(vkGetPhysicalDeviceExternalBufferPropertiesKHR) \
+	OPTIONAL(vkGetPhysicalDeviceExternalSemaphorePropertiesKHR) \
+	OPTIONAL(vkGetPhysicalDeviceExternalFencePropertiesKHR) \
+	OPTIONAL(vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR) \
+	OPTIONAL(vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR) \
+	OPTIONAL(vkGetPhysicalDeviceSurfaceCapabilities2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceSurfaceFormats2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceDisplayProperties2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceDisplayPlaneProperties2KHR) \
+	OPTIONAL(vkGetDisplayModeProperties2KHR) \
+	OPTIONAL(vkGetDisplayPlaneCapabilities2KHR) \
+	OPTIONAL(vkGetPhysicalDeviceFragmentShadingRatesKHR) \
+	OPTIONAL(vkCreateDebugReportCallbackEXT) \
+	OPTIONAL(vkDestroyDebugReportCallbackEXT) \
+	OPTIONAL(vkDebugReportMessageEXT) \
+	OPTIONAL(vkGetPhysicalDeviceExternalImageFormatPropertiesNV) \
+	OPTIONAL(vkReleaseDisplayEXT) \
+	OPTIONAL(vkGetPhysicalDeviceSurfaceCapabilities2EXT) \
+	OPTIONAL(vkCreateDebugUtilsMessengerEXT) \
+	OPTIONAL(vkDestroyDebugUtilsMessengerEXT) \
+	OPTIONAL(vkSubmitDebugUtilsMessageEXT) \
+	OPTIONAL(vkGetPhysicalDeviceMultisamplePropertiesEXT) \
+	OPTIONAL(vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) \
+	OPTIONAL(vkGetPhysicalDeviceToolPropertiesEXT) \
+	OPTIONAL(vkGetPhysicalDeviceCooperativeMatrixPropertiesNV) \
+	OPTIONAL(vkGetPhysicalDeviceSupportedFramebufferMixedSamplesCombinationsNV) \
+	OPTIONAL(vkCreateHeadlessSurfaceEXT) \
+	OPTIONAL(vkAcquireWinrtDisplayNV) \
+	OPTIONAL(vkGetWinrtDisplayNV) \
+
+#define VK_DEVICE_FUNCTIONS(REQUIRED, OPTIONAL) \
+	REQUIRED(vkDestroyDevice) \
+	REQUIRED(vkGetDeviceQueue) \
+	REQUIRED(vkQueueSubmit) \
+	REQUIRED(vkQueueWaitIdle) \
+	REQUIRED(vkDeviceWaitIdle) \
+	REQUIRED(vkAllocateMemory) \
+	REQUIRED(vkFreeMemory) \
+	REQUIRED(vkMapMemory) \
+	REQUIRED(vkUnmapMemory) \
+	REQUIRED(vkFlushMappedMemoryRanges) \
+	REQUIRED(vkInvalidateMappedMemoryRanges) \
+	REQUIRED(vkGetDeviceMemoryCommitment) \
+	REQUIRED(vkBindBufferMemory) \
+	REQUIRED(vkBindImageMemory) \
+	REQUIRED(vkGetBufferMemoryRequirements) \
+	REQUIRED(vkGetImageMemoryRequirements) \
+	REQUIRED(vkGetImageSparseMemoryRequirements) \
+	REQUIRED(vkQueueBindSparse) \
+	REQUIRED(vkCreateFence) \
+	REQUIRED(vkDestroyFence) \
+	REQUIRED(vkResetFences) \
+	REQUIRED(vkGetFenceStatus) \
+	REQUIRED(vkWaitForFences) \
+	REQUIRED(vkCreateSemaphore) \
+	REQUIRED(vkDestroySemaphore) \
+	REQUIRED(vkCreateEvent) \
+	REQUIRED(vkDestroyEvent) \
+	REQUIRED(vkGetEventStatus) \
+	REQUIRED(vkSetEvent) \
+	REQUIRED(vkResetEvent) \
+	REQUIRED(vkCreateQueryPool) \
+	REQUIRED(vkDestroyQueryPool) \
+	REQUIRED(vkGetQueryPoolResults) \
+	REQUIRED(vkCreateBuffer) \
+	REQUIRED(vkDestroyBuffer) \
+	REQUIRED(vkCreateBufferView) \
+	REQUIRED(vkDestroyBufferView) \
+	REQUIRED(vkCreateImage) \
+	REQUIRED(vkDestroyImage) \
+	REQUIRED(vkGetImageSubresourceLayout) \
+	REQUIRED(vkCreateImageView) \
+	REQUIRED(vkDestroyImageView) \
+	REQUIRED(vkCreateShaderModule) \
+	REQUIRED(vkDestroyShaderModule) \
+	REQUIRED(vkCreatePipelineCache) \
+	REQUIRED(vkDestroyPipelineCache) \
+	REQUIRED(vkGetPipelineCacheData) \
+	REQUIRED(vkMergePipelineCaches) \
+	REQUIRED(vkCreateGraphicsPipelines) \
+	REQUIRED(vkCreateComputePipelines) \
+	REQUIRED(vkDestroyPipeline) \
+	REQUIRED(vkCreatePipelineLayout) \
+	REQUIRED(vkDestroyPipelineLayout) \
+	REQUIRED(vkCreateSampler) \
+	REQUIRED(vkDestroySampler) \
+	REQUIRED(vkCreateDescriptorSetLayout) \
+	REQUIRED(vkDestroyDescriptorSetLayout) \
+	REQUIRED(vkCreateDescriptorPool) \
+	REQUIRED(vkDestroyDescriptorPool) \
+	REQUIRED(vkResetDescriptorPool) \
+	REQUIRED(vkAllocateDescriptorSets) \
+	REQUIRED(vkFreeDescriptorSets) \
+	REQUIRED(vkUpdateDescriptorSets) \
+	REQUIRED(vkCreateFramebuffer) \
+	REQUIRED(vkDestroyFramebuffer) \
+	REQUIRED(vkCreateRenderPass) \
+	REQUIRED(vkDestroyRenderPass) \
+	REQUIRED(vkGetRenderAreaGranularity) \
+	REQUIRED(vkCreateCommandPool) \
+	REQUIRED(vkDestroyCommandPool) \
+	REQUIRED(vkResetCommandPool) \
+	REQUIRED(vkAllocateCommandBuffers) \
+	REQUIRED(vkFreeCommandBuffers) \
+	REQUIRED(vkBeginCommandBuffer) \
+	REQUIRED(vkEndCommandBuffer) \
+	REQUIRED(vkResetCommandBuffer) \
+	REQUIRED(vkCmdBindPipeline) \
+	REQUIRED(vkCmdSetViewport) \
+	REQUIRED(vkCmdSetScissor) \
+	REQUIRED(vkCmdSetLineWidth) \
+	REQUIRED(vkCmdSetDepthBias) \
+	REQUIRED(vkCmdSetBlendConstants) \
+	REQUIRED(vkCmdSetDepthBounds) \
+	REQUIRED(vkCmdSetStencilCompareMask) \
+	REQUIRED(vkCmdSetStencilWriteMask) \
+	REQUIRED(vkCmdSetStencilReference) \
+	REQUIRED(vkCmdBindDescriptorSets) \
+	REQUIRED(vkCmdBindIndexBuffer) \
+	REQUIRED(vkCmdBindVertexBuffers) \
+	REQUIRED(vkCmdDraw) \
+	REQUIRED(vkCmdDrawIndexed) \
+	REQUIRED(vkCmdDrawIndirect) \
+	REQUIRED(vkCmdDrawIndexedIndirect) \
+	REQUIRED(vkCmdDispatch) \
+	REQUIRED(vkCmdDispatchIndirect) \
+	REQUIRED(vkCmdCopyBuffer) \
+	REQUIRED(vkCmdCopyImage) \
+	REQUIRED(vkCmdBlitImage) \
+	REQUIRED(vkCmdCopyBufferToImage) \
+	REQUIRED(vkCmdCopyImageToBuffer) \
+	REQUIRED(vkCmdUpdateBuffer) \
+	REQUIRED(vkCmdFillBuffer) \
+	REQUIRED(vkCmdClearColorImage) \
+	REQUIRED(vkCmdClearDepthStencilImage) \
+	REQUIRED(vkCmdClearAttachments) \
+	REQUIRED(vkCmdResolveImage) \
+	REQUIRED(vkCmdSetEvent) \
+	REQUIRED(vkCmdResetEvent) \
+	REQUIRED(vkCmdWaitEvents) \
+	REQUIRED(vkCmdPipelineBarrier) \
+	REQUIRED(vkCmdBeginQuery) \
+	REQUIRED(vkCmdEndQuery) \
+	REQUIRED(vkCmdResetQueryPool) \
+	REQUIRED(vkCmdWriteTimestamp) \
+	REQUIRED(vkCmdCopyQueryPoolResults) \
+	REQUIRED(vkCmdPushConstants) \
+	REQUIRED(vkCmdBeginRenderPass) \
+	REQUIRED(vkCmdNextSubpass) \
+	REQUIRED(vkCmdEndRenderPass) \
+	REQUIRED(vkCmdExecuteCommands) \
+	OPTIONAL(vkBindBufferMemory2) \
+	OPTIONAL(vkBindImageMemory2) \
+	OPTIONAL(vkGetDeviceGroupPeerMemoryFeatures) \
+	OPTIONAL(vkCmdSetDeviceMask) \
+	OPTIONAL(vkCmdDispatchBase) \
+	OPTIONAL(vkGetImageMemoryRequirements2) \
+	OPTIONAL(vkGetBufferMemoryRequirements2) \
+	OPTIONAL(vkGetImageSparseMemoryRequirements2) \
+	OPTIONAL(vkTrimCommandPool) \
+	OPTIONAL(vkGetDeviceQueue2) \
+	OPTIONAL(vkCreateSamplerYcbcrConversion) \
+	OPTIONAL(vkDestroySamplerYcbcrConversion) \
+	OPTIONAL(vkCreateDescriptorUpdateTemplate) \
+	OPTIONAL(vkDestroyDescriptorUpdateTemplate) \
+	OPTIONAL(vkUpdateDescriptorSetWithTemplate) \
+	OPTIONAL(vkGetDescriptorSetLayoutSupport) \
+	OPTIONAL(vkCmdDrawIndirectCount) \
+	OPTIONAL(vkCmdDrawIndexedIndirectCount) \
+	OPTIONAL(vkCreateRenderPass2) \
+	OPTIONAL(vkCmdBeginRenderPass2) \
+	OPTIONAL(vkCmdNextSubpass2) \
+	OPTIONAL(vkCmdEndRenderPass2) \
+	OPTIONAL(vkResetQueryPool) \
+	OPTIONAL(vkGetSemaphoreCounterValue) \
+	OPTIONAL(vkWaitSemaphores) \
+	OPTIONAL(vkSignalSemaphore) \
+	OPTIONAL(vkGetBufferDeviceAddress) \
+	OPTIONAL(vkGetBufferOpaqueCaptureAddress) \
+	OPTIONAL(vkGetDeviceMemoryOpaqueCaptureAddress) \
+	OPTIONAL(vkCreateSwapchainKHR) \
+	OPTIONAL(vkDestroySwapchainKHR) \
+	OPTIONAL(vkGetSwapchainImagesKHR) \
+	OPTIONAL(vkAcquireNextImageKHR) \
+	OPTIONAL(vkQueuePresentKHR) \
+	OPTIONAL(vkGetDeviceGroupPresentCapabilitiesKHR) \
+	OPTIONAL(vkGetDeviceGroupSurfacePresentModesKHR) \
+	OPTIONAL(vkAcquireNextImage2KHR) \
+	OPTIONAL(vkCreateSharedSwapchainsKHR) \
+	OPTIONAL(vkGetDeviceGroupPeerMemoryFeaturesKHR) \
+	OPTIONAL(vkCmdSetDeviceMaskKHR) \
+	OPTIONAL(vkCmdDispatchBaseKHR) \
+	OPTIONAL(vkTrimCommandPoolKHR) \
+	OPTIONAL(vkGetMemoryFdKHR) \
+	OPTIONAL(vkGetMemoryFdPropertiesKHR) \
+	OPTIONAL(vkImportSemaphoreFdKHR) \
+	OPTIONAL(vkGetSemaphoreFdKHR) \
+	OPTIONAL(vkCmdPushDescriptorSetKHR) \
+	OPTIONAL(vkCmdPushDescriptorSetWithTemplateKHR) \
+	OPTIONAL(vkCreateDescriptorUpdateTemplateKHR) \
+	OPTIONAL(vkDestroyDescriptorUpdateTemplateKHR) \
+	OPTIONAL(vkUpdateDescriptorSetWithTemplateKHR) \
+	OPTIONAL(vkCreateRenderPass2KHR) \
+	OPTIONAL(vkCmdBeginRenderPass2KHR) \
+	OPTIONAL(vkCmdNextSubpass2KHR) \
+	OPTIONAL(vkCmdEndRenderPass2KHR) \
+	OPTIONAL(vkGetSwapchainStatusKHR) \
+	OPTIONAL(vkImportFenceFdKHR) \
+	OPTIONAL(vkGetFenceFdKHR) \
+	OPTIONAL(vkAcquireProfilingLockKHR) \
+	OPTIONAL(vkReleaseProfilingLockKHR) \
+	OPTIONAL(vkGetImageMemoryRequirements2KHR) \
+	OPTIONAL(vkGetBufferMemoryRequirements2KHR) \
+	OPTIONAL(vkGetImageSparseMemoryRequirements2KHR) \
+	OPTIONAL(vkCreateSamplerYcbcrConversionKHR) \
+	OPTIONAL(vkDestroySamplerYcbcrConversionKHR) \
+	OPTIONAL(vkBindBufferMemory2KHR) \
+	OPTIONAL(vkBindImageMemory2KHR) \
+	OPTIONAL(vkGetDescriptorSetLayoutSupportKHR) \
+	OPTIONAL(vkCmdDrawIndirectCountKHR) \
+	OPTIONAL(vkCmdDrawIndexedIndirectCountKHR) \
+	OPTIONAL(vkGetSemaphoreCounterValueKHR) \
+	OPTIONAL(vkWaitSemaphoresKHR) \
+	OPTIONAL(vkSignalSemaphoreKHR) \
+	OPTIONAL(vkCmdSetFragmentShadingRateKHR) \
+	OPTIONAL(vkGetBufferDeviceAddressKHR) \
+	OPTIONAL(vkGetBufferOpaqueCaptureAddressKHR) \
+	OPTIONAL(vkGetDeviceMemoryOpaqueCaptureAddressKHR) \
+	OPTIONAL(vkCreateDeferredOperationKHR) \
+	OPTIONAL(vkDestroyDeferredOperationKHR) \
+	OPTIONAL(vkGetDeferredOperationMaxConcurrencyKHR) \
+	OPTIONAL(vkGetDeferredOperationResultKHR) \
+	OPTIONAL(vkDeferredOperationJoinKHR) \
+	OPTIONAL(vkGetPipelineExecutablePropertiesKHR) \
+	OPTIONAL(vkGetPipelineExecutableStatisticsKHR) \
+	OPTIONAL(vkGetPipelineExecutableInternalRepresentationsKHR) \
+	OPTIONAL(vkCmdSetEvent2KHR) \
+	OPTIONAL(vkCmdResetEvent2KHR) \
+	OPTIONAL(vkCmdWaitEvents2KHR) \
+	OPTIONAL(vkCmdPipelineBarrier2KHR) \
+	OPTIONAL(vkCmdWriteTimestamp2KHR) \
+	OPTIONAL(vkQueueSubmit2KHR) \
+	OPTIONAL(vkCmdWriteBufferMarker2AMD) \
+	OPTIONAL(vkGetQueueCheckpointData2NV) \
+	OPTIONAL(vkCmdCopyBuffer2KHR) \
+	OPTIONAL(vkCmdCopyImage2KHR) \
+	OPTIONAL(vkCmdCopyBufferToImage2KHR) \
+	OPTIONAL(vkCmdCopyImageToBuffer2KHR) \
+	OPTIONAL(vkCmdBlitImage2KHR) \
+	OPTIONAL(vkCmdResolveImage2KHR) \
+	OPTIONAL(vkDebugMarkerSetObjectTagEXT) \
+	OPTIONAL(vkDebugMarkerSetObjectNameEXT) \
+	OPTIONAL(vkCmdDebugMarkerBeginEXT) \
+	OPTIONAL(vkCmdDebugMarkerEndEXT) \
+	OPTIONAL(vkCmdDebugMarkerInsertEXT) \
+	OPTIONAL(vkCmdBindTransformFeedbackBuffersEXT) \
+	OPTIONAL(vkCmdBeginTransformFeedbackEXT) \
+	OPTIONAL(vkCmdEndTransformFeedbackEXT) \
+	OPTIONAL(vkCmdBeginQueryIndexedEXT) \
+	OPTIONAL(vkCmdEndQueryIndexedEXT) \
+	OPTIONAL(vkCmdDrawIndirectByteCountEXT) \
+	OPTIONAL(vkGetImageViewHandleNVX) \
+	OPTIONAL(vkGetImageViewAddressNVX) \
+	OPTIONAL(vkCmdDrawIndirectCountAMD) \
+	OPTIONAL(vkCmdDrawIndexedIndirectCountAMD) \
+	OPTIONAL(vkGetShaderInfoAMD) \
+	OPTIONAL(vkCmdBeginConditionalRenderingEXT) \
+	OPTIONAL(vkCmdEndConditionalRenderingEXT) \
+	OPTIONAL(vkCmdSetViewportWScalingNV) \
+	OPTIONAL(vkDisplayPowerControlEXT) \
+	OPTIONAL(vkRegisterDeviceEventEXT) \
+	OPTIONAL(vkRegisterDisplayEventEXT) \
+	OPTIONAL(vkGetSwapchainCounterEXT) \
+	OPTIONAL(vkGetRefreshCycleDurationGOOGLE) \
+	OPTIONAL(vkGetPastPresentationTimingGOOGLE) \
+	OPTIONAL(vkCmdSetDiscardRectangleEXT) \
+	OPTIONAL(vkSetHdrMetadataEXT) \
+	OPTIONAL(vkSetDebugUtilsObjectNameEXT) \
+	OPTIONAL(vkSetDebugUtilsObjectTagEXT) \
+	OPTIONAL(vkQueueBeginDebugUtilsLabelEXT) \
+	OPTIONAL(vkQueueEndDebugUtilsLabelEXT) \
+	OPTIONAL(vkQueueInsertDebugUtilsLabelEXT) \
+	OPTIONAL(vkCmdBeginDebugUtilsLabelEXT) \
+	OPTIONAL(vkCmdEndDebugUtilsLabelEXT) \
+	OPTIONAL(vkCmdInsertDebugUtilsLabelEXT) \
+	OPTIONAL(vkCmdSetSampleLocationsEXT) \
+	OPTIONAL(vkGetImageDrmFormatModifierPropertiesEXT) \
+	OPTIONAL(vkCreateValidationCacheEXT) \
+	OPTIONAL(vkDestroyValidationCacheEXT) \
+	OPTIONAL(vkMergeValidationCachesEXT) \
+	OPTIONAL(vkGetValidationCacheDataEXT) \
+	OPTIONAL(vkCmdBindShadingRateImageNV) \
+	OPTIONAL(vkCmdSetViewportShadingRatePaletteNV) \
+	OPTIONAL(vkCmdSetCoarseSampleOrderNV) \
+	OPTIONAL(vkCreateAccelerationStructureNV) \
+	OPTIONAL(vkDestroyAccelerationStructureNV) \
+	OPTIONAL(vkGetAccelerationStructureMemoryRequirementsNV) \
+	OPTIONAL(vkBindAccelerationStructureMemoryNV) \
+	OPTIONAL(vkCmdBuildAccelerationStructureNV) \
+	OPTIONAL(vkCmdCopyAccelerationStructureNV) \
+	OPTIONAL(vkCmdTraceRaysNV) \
+	OPTIONAL(vkCreateRayTracingPipelinesNV) \
+	OPTIONAL(vkGetRayTracingShaderGroupHandlesKHR) \
+	OPTIONAL(vkGetRayTracingShaderGroupHandlesNV) \
+	OPTIONAL(vkGetAccelerationStructureHandleNV) \
+	OPTIONAL(vkCmdWriteAccelerationStructuresPropertiesNV) \
+	OPTIONAL(vkCompileDeferredNV) \
+	OPTIONAL(vkGetMemoryHostPointerPropertiesEXT) \
+	OPTIONAL(vkCmdWriteBufferMarkerAMD) \
+	OPTIONAL(vkGetCalibratedTimestampsEXT) \
+	OPTIONAL(vkCmdDrawMeshTasksNV) \
+	OPTIONAL(vkCmdDrawMeshTasksIndirectNV) \
+	OPTIONAL(vkCmdDrawMeshTasksIndirectCountNV) \
+	OPTIONAL(vkCmdSetExclusiveScissorNV) \
+	OPTIONAL(vkCmdSetCheckpointNV) \
+	OPTIONAL(vkGetQueueCheckpointDataNV) \
+	OPTIONAL(vkInitializePerformanceApiINTEL) \
+	OPTIONAL(vkUninitializePerformanceApiINTEL) \
+	OPTIONAL(vkCmdSetPerformanceMarkerINTEL) \
+	OPTIONAL(vkCmdSetPerformanceStreamMarkerINTEL) \
+	OPTIONAL(vkCmdSetPerformanceOverrideINTEL) \
+	OPTIONAL(vkAcquirePerformanceConfigurationINTEL) \
+	OPTIONAL(vkReleasePerformanceConfigurationINTEL) \
+	OPTIONAL(vkQueueSetPerformanceConfigurationINTEL) \
+	OPTIONAL(vkGetPerformanceParameterINTEL) \
+	OPTIONAL(vkSetLocalDimmingAMD) \
+	OPTIONAL(vkGetBufferDeviceAddressEXT) \
+	OPTIONAL(vkCmdSetLineStippleEXT) \
+	OPTIONAL(vkResetQueryPoolEXT) \
+	OPTIONAL(vkCmdSetCullModeEXT) \
+	OPTIONAL(vkCmdSetFrontFaceEXT) \
+	OPTIONAL(vkCmdSetPrimitiveTopologyEXT) \
+	OPTIONAL(vkCmdSetViewportWithCountEXT) \
+	OPTIONAL(vkCmdSetScissorWithCountEXT) \
+	OPTIONAL(vkCmdBindVertexBuffers2EXT) \
+	OPTIONAL(vkCmdSetDepthTestEnableEXT) \
+	OPTIONAL(vkCmdSetDepthWriteEnableEXT) \
+	OPTIONAL(vkCmdSetDepthCompareOpEXT) \
+	OPTIONAL(vkCmdSetDepthBoundsTestEnableEXT) \
+	OPTIONAL(vkCmdSetStencilTestEnableEXT) \
+	OPTIONAL(vkCmdSetStencilOpEXT) \
+	OPTIONAL(vkGetGeneratedCommandsMemoryRequirementsNV) \
+	OPTIONAL(vkCmdPreprocessGeneratedCommandsNV) \
+	OPTIONAL(vkCmdExecuteGeneratedCommandsNV) \
+	OPTIONAL(vkCmdBindPipelineShaderGroupNV) \
+	OPTIONAL(vkCreateIndirectCommandsLayoutNV) \
+	OPTIONAL(vkDestroyIndirectCommandsLayoutNV) \
+	OPTIONAL(vkCreatePrivateDataSlotEXT) \
+	OPTIONAL(vkDestroyPrivateDataSlotEXT) \
+	OPTIONAL(vkSetPrivateDataEXT) \
+	OPTIONAL(vkGetPrivateDataEXT) \
+	OPTIONAL(vkCmdSetFragmentShadingRateEnumNV) \
+	OPTIONAL(vkCreateAccelerationStructureKHR) \
+	OPTIONAL(vkDestroyAccelerationStructureKHR) \
+	OPTIONAL(vkCmdBuildAccelerationStructuresKHR) \
+	OPTIONAL(vkCmdBuildAccelerationStructuresIndirectKHR) \
+	OPTIONAL(vkBuildAccelerationStructuresKHR) \
+	OPTIONAL(vkCopyAccelerationStructureKHR) \
+	OPTIONAL(vkCopyAccelerationStructureToMemoryKHR) \
+	OPTIONAL(vkCopyMemoryToAccelerationStructureKHR) \
+	OPTIONAL(vkWriteAccelerationStructuresPropertiesKHR) \
+	OPTIONAL(vkCmdCopyAccelerationStructureKHR) \
+	OPTIONAL(vkCmdCopyAccelerationStructureToMemoryKHR) \
+	OPTIONAL(vkCmdCopyMemoryToAccelerationStructureKHR) \
+	OPTIONAL(vkGetAccelerationStructureDeviceAddressKHR) \
+	OPTIONAL(vkCmdWriteAccelerationStructuresPropertiesKHR) \
+	OPTIONAL(vkGetDeviceAccelerationStructureCompatibilityKHR) \
+	OPTIONAL(vkGetAccelerationStructureBuildSizesKHR) \
+	OPTIONAL(vkCmdTraceRaysKHR) \
+	OPTIONAL(vkCreateRayTracingPipelinesKHR) \
+	OPTIONAL(vkGetRayTracingCaptureReplayShaderGroupHandlesKHR) \
+	OPTIONAL(vkCmdTraceRaysIndirectKHR) \
+	OPTIONAL(vkGetRayTracingShaderGroupStackSizeKHR) \
+	OPTIONAL(vkCmdSetRayTracingPipelineStackSizeKHR) \
+
+//END GENERATED DISPATCH
+
+#define VK_DISPATCH_MEMBER(fn) PFN_##fn fn;
 
-__declspec(noreturn) void Abort(LPCTSTR message)
+struct VulkanGlobalDispatch {
+	VK_GLOBAL_FUNCTIONS(VK_DISPATCH_MEMBER, VK_DISPATCH_MEMBER)
+};
+
+struct VulkanInstanceDispatch {
+	VK_INSTANCE_FUNCTIONS(VK_DISPATCH_MEMBER, VK_DISPATCH_MEMBER)
+};
+
+struct VulkanDeviceDispatch {
+	VK_DEVICE_FUNCTIONS(VK_DISPATCH_MEMBER, VK_DISPATCH_MEMBER)
+};
+
+#undef VK_DISPATCH_MEMBER
+
+VulkanGlobalDispatch LoadGlobalDispatch(PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr)
 {
-	TCERR << message << std::endl;
-	ExitProcess(1);
+	VulkanGlobalDispatch d{};
+#define VK_DISPATCH_REQUIRED(fn) \
+	if(!(d.fn = (PFN_##fn)vkGetInstanceProcAddr(nullptr, #fn))) \
+		Abort(TEXT("vkGetInstanceProcAddr failed for " #fn));
+#define VK_DISPATCH_OPTIONAL(fn) d.fn = (PFN_##fn)vkGetInstanceProcAddr(nullptr, #fn);
+	VK_GLOBAL_FUNCTIONS(VK_DISPATCH_REQUIRED, VK_DISPATCH_OPTIONAL)
+#undef VK_DISPATCH_REQUIRED
+#undef VK_DISPATCH_OPTIONAL
+	return d;
 }
 
-__declspec(noreturn) void Win32Abort(LPCTSTR message)
+VulkanInstanceDispatch LoadInstanceDispatch(PFN_vkGetInstanceProcAddr vkGetInstanceProcAddr, VkInstance instance)
 {
-	DWORD last_error = GetLastError();
-	LPTSTR buffer;
-	DWORD size_in_tchar = FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, 0, last_error, 0, (LPTSTR)&buffer, 0, 0);
+	VulkanInstanceDispatch d{};
+#define VK_DISPATCH_REQUIRED(fn) \
+	if(!(d.fn = (PFN_##fn)vkGetInstanceProcAddr(instance, #fn))) \
+		Abort(TEXT("vkGetInstanceProcAddr failed for " #fn));
+#define VK_DISPATCH_OPTIONAL(fn) d.fn = (PFN_##fn)vkGetInstanceProcAddr(instance, #fn);
+	VK_INSTANCE_FUNCTIONS(VK_DISPATCH_REQUIRED, VK_DISPATCH_OPTIONAL)
+#undef VK_DISPATCH_REQUIRED
+#undef VK_DISPATCH_OPTIONAL
+	return d;
+}
 
-	if(size_in_tchar) {
-		TCERR << message << std::endl
-		      << buffer << "std::endl";
-		LocalFree(buffer);
+VulkanDeviceDispatch LoadDeviceDispatch(PFN_vkGetDeviceProcAddr vkGetDeviceProcAddr, VkDevice device)
+{
+	VulkanDeviceDispatch d{};
+#define VK_DISPATCH_REQUIRED(fn) \
+	if(!(d.fn = (PFN_##fn)vkGetDeviceProcAddr(device, #fn))) \
+		Abort(TEXT("vkGetDeviceProcAddr failed for " #fn));
+#define VK_DISPATCH_OPTIONAL(fn) d.fn = (PFN_##fn)vkGetDeviceProcAddr(device, #fn);
+	VK_DEVICE_FUNCTIONS(VK_DISPATCH_REQUIRED, VK_DISPATCH_OPTIONAL)
+#undef VK_DISPATCH_REQUIRED
+#undef VK_DISPATCH_OPTIONAL
+	return d;
+}
+
+//Host memory
+//Optional VkAllocationCallbacks for the host memory the driver allocates on the application's behalf.
+//Each allocation scope gets its own arena of size class pools, so short lived command scope allocations
+//never fragment the chunks holding instance and device lifetime objects. Threads take and return blocks
+//through a small per-thread cache and only lock the arena's pool to move a batch. Chunks are kept for the
+//lifetime of the process, so blocks can be freed from any thread, in any order, even after the device is gone.
+#define HOST_SCOPES (VK_SYSTEM_ALLOCATION_SCOPE_INSTANCE + 1)
+#define HOST_SIZE_CLASSES 9 //16 to 4096 bytes, larger blocks go to the system heap
+#define HOST_MIN_BLOCK 16
+#define HOST_CHUNK_SIZE (64 * 1024)
+#define HOST_CACHE_BATCH 32 //blocks moved between a thread cache and its pool at once
+#define HOST_LARGE_CLASS 0xFF
+
+//Placed right before the pointer handed to the driver
+struct HostBlockHeader {
+	uint64_t size;
+	uint32_t offset; //from the start of the block
+	uint8_t sizeClass;
+	uint8_t scope;
+	uint16_t reserved;
+};
+static_assert(sizeof(HostBlockHeader) == HOST_MIN_BLOCK, "the header keeps blocks 16 byte aligned");
+
+struct HostFreeBlock {
+	HostFreeBlock* next;
+};
+
+struct HostPool {
+	std::mutex mutex;
+	HostFreeBlock* freeBlocks;
+	std::vector<void*> chunks;
+};
+
+struct HostScopeStats {
+	std::atomic<uint64_t> allocations; //since start, reallocations count once
+	std::atomic<uint64_t> liveAllocations;
+	std::atomic<uint64_t> liveBytes;
+	std::atomic<uint64_t> peakBytes;
+	std::atomic<uint64_t> internalBytes; //reported through pfnInternalAllocation, not served by us
+};
+
+struct HostAllocator {
+	HostPool pools[HOST_SCOPES][HOST_SIZE_CLASSES];
+	HostScopeStats stats[HOST_SCOPES];
+	VkAllocationCallbacks callbacks;
+};
+
+static HostAllocator hostAllocator;
+//Passed as pAllocator to every create and destroy call, null leaves host memory to the driver
+static const VkAllocationCallbacks* allocator;
+
+struct HostThreadCache {
+	HostFreeBlock* freeBlocks[HOST_SCOPES][HOST_SIZE_CLASSES];
+	uint32_t counts[HOST_SCOPES][HOST_SIZE_CLASSES];
+
+	~HostThreadCache()
+	{
+		for(uint32_t scope = 0; scope < HOST_SCOPES; ++scope)
+			for(uint32_t sizeClass = 0; sizeClass < HOST_SIZE_CLASSES; ++sizeClass)
+				while(freeBlocks[scope][sizeClass]) {
+					HostPool& pool = hostAllocator.pools[scope][sizeClass];
+					HostFreeBlock* block = freeBlocks[scope][sizeClass];
+					freeBlocks[scope][sizeClass] = block->next;
+					std::lock_guard<std::mutex> lock(pool.mutex);
+					block->next = pool.freeBlocks;
+					pool.freeBlocks = block;
+				}
 	}
+};
 
-	ExitProcess(last_error);
+static thread_local HostThreadCache hostThreadCache;
+
+uint32_t HostSizeClass(size_t size)
+{
+	uint32_t sizeClass = 0;
+	while((static_cast<size_t>(HOST_MIN_BLOCK) << sizeClass) < size)
+		++sizeClass;
+	return sizeClass;
+}
+
+void* HostPoolAllocate(uint32_t scope, uint32_t sizeClass)
+{
+	HostFreeBlock*& cached = hostThreadCache.freeBlocks[scope][sizeClass];
+	if(!cached) {
+		//Refill with a batch, carving a new chunk when the pool is empty
+		HostPool& pool = hostAllocator.pools[scope][sizeClass];
+		size_t blockSize = static_cast<size_t>(HOST_MIN_BLOCK) << sizeClass;
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		if(!pool.freeBlocks) {
+			auto chunk = static_cast<uint8_t*>(malloc(HOST_CHUNK_SIZE));
+			if(!chunk)
+				return nullptr;
+			pool.chunks.push_back(chunk);
+			for(size_t offset = HOST_CHUNK_SIZE; offset >= blockSize; offset -= blockSize) {
+				auto block = reinterpret_cast<HostFreeBlock*>(chunk + offset - blockSize);
+				block->next = pool.freeBlocks;
+				pool.freeBlocks = block;
+			}
+		}
+		for(uint32_t i = 0; i < HOST_CACHE_BATCH && pool.freeBlocks; ++i) {
+			HostFreeBlock* block = pool.freeBlocks;
+			pool.freeBlocks = block->next;
+			block->next = cached;
+			cached = block;
+			++hostThreadCache.counts[scope][sizeClass];
+		}
+	}
+
+	HostFreeBlock* block = cached;
+	cached = block->next;
+	--hostThreadCache.counts[scope][sizeClass];
+	return block;
+}
+
+void HostPoolFree(uint32_t scope, uint32_t sizeClass, void* memory)
+{
+	HostFreeBlock*& cached = hostThreadCache.freeBlocks[scope][sizeClass];
+	auto block = static_cast<HostFreeBlock*>(memory);
+	block->next = cached;
+	cached = block;
+
+	//Hand a batch back once the cache holds two, so a thread that only frees does not hoard blocks
+	if(++hostThreadCache.counts[scope][sizeClass] >= HOST_CACHE_BATCH * 2) {
+		HostPool& pool = hostAllocator.pools[scope][sizeClass];
+		std::lock_guard<std::mutex> lock(pool.mutex);
+		for(uint32_t i = 0; i < HOST_CACHE_BATCH; ++i) {
+			block = cached;
+			cached = block->next;
+			block->next = pool.freeBlocks;
+			pool.freeBlocks = block;
+		}
+		hostThreadCache.counts[scope][sizeClass] -= HOST_CACHE_BATCH;
+	}
+}
+
+void* VKAPI_PTR HostAllocate(void*, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+	if(!size)
+		return nullptr;
+
+	//Room for the header and for moving the pointer up to the requested alignment
+	alignment = std::max(alignment, static_cast<size_t>(HOST_MIN_BLOCK));
+	size_t blockSize = size + alignment;
+	auto scope = static_cast<uint32_t>(allocationScope);
+	ASSERT(scope < HOST_SCOPES);
+	uint32_t sizeClass = HostSizeClass(blockSize);
+	uint8_t* block;
+	if(sizeClass < HOST_SIZE_CLASSES)
+		block = static_cast<uint8_t*>(HostPoolAllocate(scope, sizeClass));
+	else {
+		sizeClass = HOST_LARGE_CLASS;
+		block = static_cast<uint8_t*>(malloc(blockSize));
+	}
+	if(!block)
+		return nullptr;
+
+	auto address = reinterpret_cast<uintptr_t>(block) + sizeof(HostBlockHeader);
+	address = (address + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+	auto memory = reinterpret_cast<uint8_t*>(address);
+	auto header = reinterpret_cast<HostBlockHeader*>(memory) - 1;
+	*header = {size, static_cast<uint32_t>(memory - block), static_cast<uint8_t>(sizeClass), static_cast<uint8_t>(scope), 0};
+
+	HostScopeStats& stats = hostAllocator.stats[scope];
+	stats.allocations.fetch_add(1, std::memory_order_relaxed);
+	stats.liveAllocations.fetch_add(1, std::memory_order_relaxed);
+	uint64_t liveBytes = stats.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+	uint64_t peakBytes = stats.peakBytes.load(std::memory_order_relaxed);
+	while(liveBytes > peakBytes && !stats.peakBytes.compare_exchange_weak(peakBytes, liveBytes, std::memory_order_relaxed))
+		;
+	return memory;
+}
+
+void VKAPI_PTR HostFree(void*, void* memory)
+{
+	if(!memory)
+		return;
+
+	auto header = static_cast<HostBlockHeader*>(memory) - 1;
+	HostScopeStats& stats = hostAllocator.stats[header->scope];
+	stats.liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+	stats.liveBytes.fetch_sub(header->size, std::memory_order_relaxed);
+
+	uint8_t* block = static_cast<uint8_t*>(memory) - header->offset;
+	if(header->sizeClass == HOST_LARGE_CLASS)
+		free(block);
+	else
+		HostPoolFree(header->scope, header->sizeClass, block);
+}
+
+//The alignment of a reallocation is the one of the original allocation
+void* VKAPI_PTR HostReallocate(void* userData, void* original, size_t size, size_t alignment, VkSystemAllocationScope allocationScope)
+{
+	if(!original)
+		return HostAllocate(userData, size, alignment, allocationScope);
+	if(!size) {
+		HostFree(userData, original);
+		return nullptr;
+	}
+
+	auto header = static_cast<HostBlockHeader*>(original) - 1;
+	void* memory = HostAllocate(userData, size, alignment, allocationScope);
+	if(!memory)
+		return nullptr;
+	memcpy(memory, original, static_cast<size_t>(std::min<uint64_t>(size, header->size)));
+	HostFree(userData, original);
+	return memory;
+}
+
+void VKAPI_PTR HostInternalAllocation(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope allocationScope)
+{
+	hostAllocator.stats[allocationScope].internalBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void VKAPI_PTR HostInternalFree(void*, size_t size, VkInternalAllocationType, VkSystemAllocationScope allocationScope)
+{
+	hostAllocator.stats[allocationScope].internalBytes.fetch_sub(size, std::memory_order_relaxed);
+}
+
+const VkAllocationCallbacks* HostAllocatorCallbacks()
+{
+	hostAllocator.callbacks = {nullptr, HostAllocate, HostReallocate, HostFree, HostInternalAllocation, HostInternalFree};
+	return &hostAllocator.callbacks;
+}
+
+uint64_t HostAllocatorAllocations()
+{
+	uint64_t allocations = 0;
+	for(auto& stats : hostAllocator.stats)
+		allocations += stats.allocations.load(std::memory_order_relaxed);
+	return allocations;
+}
+
+//One line per scope that allocated, "Device: 120 allocations, 80 live, 12.5 KB live, peak 20.0 KB, internal 0.0 KB\n"
+int HostAllocatorSummary(TCHAR* buffer, size_t size)
+{
+	static LPCTSTR scopeNames[HOST_SCOPES] = {TEXT("Command"), TEXT("Object"), TEXT("Cache"), TEXT("Device"), TEXT("Instance")};
+	int length = 0;
+	buffer[0] = 0;
+	for(uint32_t scope = 0; scope < HOST_SCOPES; ++scope) {
+		HostScopeStats& stats = hostAllocator.stats[scope];
+		uint64_t allocations = stats.allocations.load(std::memory_order_relaxed);
+		if(!allocations)
+			continue;
+		int written = _stprintf_s(buffer + length, size - length, TEXT("%s: %llu allocations, %llu live, %.1f KB live, peak %.1f KB, internal %.1f KB\n"), scopeNames[scope], static_cast<unsigned long long>(allocations),
+		                          static_cast<unsigned long long>(stats.liveAllocations.load(std::memory_order_relaxed)), stats.liveBytes.load(std::memory_order_relaxed) / 1024.0, stats.peakBytes.load(std::memory_order_relaxed) / 1024.0,
+		                          static_cast<int64_t>(stats.internalBytes.load(std::memory_order_relaxed)) / 1024.0);
+		if(written < 0)
+			break;
+		length += written;
+	}
+	return length;
+}
+
+//Timeline semaphore scheduler
+//Each queue owns one timeline semaphore and every submission signals its next value.
+//The CPU and other queues wait on values instead of fences, and anything used by a
+//submission is safe to reuse once the timeline has reached that submission's value.
+struct QueueTimeline {
+	VkQueue queue;
+	VkSemaphore semaphore;
+	uint64_t submitted; //value signaled by the latest submission
+	uint64_t completed; //latest value known to be reached
+};
+
+//A semaphore the next submission waits on: another queue's timeline, or a binary semaphore with value ignored
+struct TimelineWait {
+	VkSemaphore semaphore;
+	uint64_t value;
+	VkPipelineStageFlags stage;
+};
+
+#define MAX_TIMELINE_WAITS 4
+
+QueueTimeline CreateQueueTimeline(const VulkanDeviceDispatch& vkd, VkDevice device, VkQueue queue)
+{
+	VkSemaphoreTypeCreateInfo stci{VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+	stci.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	stci.initialValue = 0;
+	VkSemaphoreCreateInfo sci{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, &stci};
+	QueueTimeline timeline{queue};
+	VK_ASSERT(vkd.vkCreateSemaphore(device, &sci, allocator, &timeline.semaphore));
+	ASSERT(timeline.semaphore);
+	return timeline;
+}
+
+void DestroyQueueTimeline(const VulkanDeviceDispatch& vkd, VkDevice device, QueueTimeline& timeline)
+{
+	vkd.vkDestroySemaphore(device, timeline.semaphore, allocator);
+	timeline.semaphore = VK_NULL_HANDLE;
+}
+
+//Submits one command buffer, signaling the next timeline value and optionally a binary semaphore for presentation
+//Returns the value that marks the completion of this submission
+uint64_t TimelineSubmit(const VulkanDeviceDispatch& vkd, QueueTimeline& timeline, VkCommandBuffer commandBuffer, uint32_t waitCount, const TimelineWait* waits, VkSemaphore signalBinarySemaphore)
+{
+	ASSERT(waitCount <= MAX_TIMELINE_WAITS);
+	VkSemaphore waitSemaphores[MAX_TIMELINE_WAITS];
+	uint64_t waitValues[MAX_TIMELINE_WAITS];
+	VkPipelineStageFlags waitStages[MAX_TIMELINE_WAITS];
+	for(uint32_t i = 0; i < waitCount; ++i) {
+		waitSemaphores[i] = waits[i].semaphore;
+		waitValues[i] = waits[i].value;
+		waitStages[i] = waits[i].stage;
+	}
+
+	uint64_t value = timeline.submitted + 1;
+	VkSemaphore signalSemaphores[] = {timeline.semaphore, signalBinarySemaphore};
+	uint64_t signalValues[] = {value, 0};
+	uint32_t signalCount = signalBinarySemaphore ? 2 : 1;
+
+	VkTimelineSemaphoreSubmitInfo tssi{VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO};
+	tssi.waitSemaphoreValueCount = waitCount;
+	tssi.pWaitSemaphoreValues = waitValues;
+	tssi.signalSemaphoreValueCount = signalCount;
+	tssi.pSignalSemaphoreValues = signalValues;
+	VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO, &tssi, waitCount, waitSemaphores, waitStages, commandBuffer ? 1u : 0u, &commandBuffer, signalCount, signalSemaphores};
+	VK_ASSERT(vkd.vkQueueSubmit(timeline.queue, 1, &submitInfo, VK_NULL_HANDLE));
+
+	timeline.submitted = value;
+	return value;
+}
+
+//Non-blocking, true once the GPU has reached value
+bool TimelineReached(const VulkanDeviceDispatch& vkd, VkDevice device, QueueTimeline& timeline, uint64_t value)
+{
+	if(timeline.completed < value)
+		VK_ASSERT(vkd.vkGetSemaphoreCounterValue(device, timeline.semaphore, &timeline.completed));
+	return timeline.completed >= value;
+}
+
+//Blocks the CPU until the GPU has reached value
+void TimelineWaitValue(const VulkanDeviceDispatch& vkd, VkDevice device, QueueTimeline& timeline, uint64_t value)
+{
+	if(timeline.completed >= value)
+		return;
+
+	VkSemaphoreWaitInfo wi{VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+	wi.semaphoreCount = 1;
+	wi.pSemaphores = &timeline.semaphore;
+	wi.pValues = &value;
+	VK_ASSERT(vkd.vkWaitSemaphores(device, &wi, UINT64_MAX));
+	timeline.completed = value;
+}
+
+//GPU timestamp profiler
+//Zones wrap regions of a command buffer with a pair of timestamps. Each frame in flight owns a query pool,
+//which is read back and reset from the host once that frame's submission is known to be complete,
+//so reading results never waits on the GPU.
+#define MAX_GPU_ZONES 16
+
+struct GpuProfilerFrame {
+	VkQueryPool queryPool;
+	uint32_t zoneCount;
+	LPCTSTR zoneNames[MAX_GPU_ZONES];
+};
+
+struct GpuProfiler {
+	bool enabled;
+	double timestampPeriod; //nanoseconds per tick
+	uint64_t timestampMask;
+	uint32_t frameCount;
+	GpuProfilerFrame frames[MAX_FRAMES_IN_FLIGHT];
+	GpuProfilerFrame* current;
+
+	//Per zone totals since the last GpuProfilerAverages
+	uint32_t zoneCount;
+	LPCTSTR zoneNames[MAX_GPU_ZONES];
+	double zoneMilliseconds[MAX_GPU_ZONES];
+	uint32_t resolvedFrames;
+	//Per zone totals since GpuProfilerResetTotals, for reports over a whole run
+	double zoneTotalMilliseconds[MAX_GPU_ZONES];
+	uint64_t totalResolvedFrames;
+	//Raw begin and end ticks of the frame read back by the last GpuProfilerBeginFrame, for the timeline trace
+	uint32_t resolvedZoneCount;
+	uint64_t resolvedTimestamps[MAX_GPU_ZONES * 2];
+};
+
+GpuProfiler CreateGpuProfiler(const VulkanDeviceDispatch& vkd, VkDevice device, uint32_t frameCount, float timestampPeriod, uint32_t timestampValidBits, bool hostQueryReset)
+{
+	GpuProfiler profiler{};
+	profiler.enabled = timestampValidBits > 0 && hostQueryReset;
+	if(!profiler.enabled)
+		return profiler;
+
+	profiler.timestampPeriod = timestampPeriod;
+	profiler.timestampMask = timestampValidBits >= 64 ? UINT64_MAX : (1ull << timestampValidBits) - 1;
+	profiler.frameCount = frameCount;
+	for(uint32_t i = 0; i < frameCount; ++i) {
+		VkQueryPoolCreateInfo qpci{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+		qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		qpci.queryCount = MAX_GPU_ZONES * 2;
+		VK_ASSERT(vkd.vkCreateQueryPool(device, &qpci, allocator, &profiler.frames[i].queryPool));
+		vkd.vkResetQueryPool(device, profiler.frames[i].queryPool, 0, MAX_GPU_ZONES * 2);
+	}
+
+	return profiler;
+}
+
+void DestroyGpuProfiler(const VulkanDeviceDispatch& vkd, VkDevice device, GpuProfiler& profiler)
+{
+	for(uint32_t i = 0; i < profiler.frameCount; ++i)
+		vkd.vkDestroyQueryPool(device, profiler.frames[i].queryPool, allocator);
+	profiler.frameCount = 0;
+	profiler.enabled = false;
+}
+
+//Call before recording frame slot, once the last submission that used the slot has completed
+void GpuProfilerBeginFrame(const VulkanDeviceDispatch& vkd, VkDevice device, GpuProfiler& profiler, uint32_t slot)
+{
+	if(!profiler.enabled)
+		return;
+
+	GpuProfilerFrame& frame = profiler.frames[slot];
+	profiler.resolvedZoneCount = 0;
+	if(frame.zoneCount) {
+		uint64_t* timestamps = profiler.resolvedTimestamps;
+		VkResult result = vkd.vkGetQueryPoolResults(device, frame.queryPool, 0, frame.zoneCount * 2, sizeof(profiler.resolvedTimestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if(result == VK_SUCCESS) {
+			profiler.zoneCount = profiler.resolvedZoneCount = frame.zoneCount;
+			for(uint32_t i = 0; i < frame.zoneCount; ++i) {
+				uint64_t ticks = (timestamps[i * 2 + 1] - timestamps[i * 2]) & profiler.timestampMask;
+				profiler.zoneNames[i] = frame.zoneNames[i];
+				profiler.zoneMilliseconds[i] += ticks * profiler.timestampPeriod / 1000000.0;
+				profiler.zoneTotalMilliseconds[i] += ticks * profiler.timestampPeriod / 1000000.0;
+			}
+			++profiler.resolvedFrames;
+			++profiler.totalResolvedFrames;
+		} else if(result != VK_NOT_READY)
+			VkAbort(result, TEXT("vkGetQueryPoolResults"));
+		vkd.vkResetQueryPool(device, frame.queryPool, 0, frame.zoneCount * 2);
+	}
+
+	frame.zoneCount = 0;
+	profiler.current = &frame;
+}
+
+//Returns the zone to pass to GpuZoneEnd
+uint32_t GpuZoneBegin(const VulkanDeviceDispatch& vkd, GpuProfiler& profiler, VkCommandBuffer commandBuffer, LPCTSTR name)
+{
+	if(!profiler.enabled)
+		return 0;
+
+	GpuProfilerFrame& frame = *profiler.current;
+	ASSERT(frame.zoneCount < MAX_GPU_ZONES);
+	uint32_t zone = frame.zoneCount++;
+	frame.zoneNames[zone] = name;
+	vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, frame.queryPool, zone * 2);
+	return zone;
+}
+
+void GpuZoneEnd(const VulkanDeviceDispatch& vkd, GpuProfiler& profiler, VkCommandBuffer commandBuffer, uint32_t zone)
+{
+	if(!profiler.enabled)
+		return;
+
+	vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler.current->queryPool, zone * 2 + 1);
+}
+
+//Writes the average GPU milliseconds per zone since the last call, as "name ms, name ms", then restarts the averages
+int GpuProfilerAverages(GpuProfiler& profiler, TCHAR* buffer, size_t size)
+{
+	int length = 0;
+	buffer[0] = 0;
+	for(uint32_t i = 0; i < profiler.zoneCount && profiler.resolvedFrames; ++i) {
+		int written = _stprintf_s(buffer + length, size - length, TEXT("%s%s %.3f"), i ? TEXT(", ") : TEXT(""), profiler.zoneNames[i], profiler.zoneMilliseconds[i] / profiler.resolvedFrames);
+		if(written < 0)
+			break;
+		length += written;
+	}
+	if(!length)
+		length = _stprintf_s(buffer, size, TEXT("n/a"));
+
+	for(auto& ms : profiler.zoneMilliseconds)
+		ms = 0.0;
+	profiler.resolvedFrames = 0;
+	return length;
+}
+
+void GpuProfilerResetTotals(GpuProfiler& profiler)
+{
+	for(auto& ms : profiler.zoneTotalMilliseconds)
+		ms = 0.0;
+	profiler.totalResolvedFrames = 0;
+}
+
+//Queue busy time
+//Every command buffer of a queue is bracketed by two timestamps, in a query pool per frame in flight that is read back
+//once the frame is complete. The intervals add up to each queue's busy time, and the union of the intervals of two
+//queues gives how long both were busy at once, which is how much async work really overlapped.
+//Queues of one device share the timestamp clock, VK_TIME_DOMAIN_DEVICE_EXT of VK_EXT_calibrated_timestamps is that clock.
+struct QueueBusyInterval {
+	uint64_t begin, end; //ticks
+};
+
+struct QueueBusy {
+	bool enabled;
+	double timestampPeriod; //nanoseconds per tick
+	uint64_t timestampMask;
+	VkQueryPool queryPools[MAX_FRAMES_IN_FLIGHT];
+	bool pending[MAX_FRAMES_IN_FLIGHT];
+	std::vector<QueueBusyInterval> intervals; //since the last QueueBusySummary
+};
+
+//Disabled when the queue family has no timestamp support
+QueueBusy CreateQueueBusy(const VulkanDeviceDispatch& vkd, VkDevice device, uint32_t frameCount, float timestampPeriod, uint32_t timestampValidBits)
+{
+	QueueBusy busy{};
+	busy.enabled = timestampValidBits > 0;
+	if(!busy.enabled)
+		return busy;
+	busy.timestampPeriod = timestampPeriod;
+	busy.timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+	for(uint32_t i = 0; i < frameCount; ++i) {
+		VkQueryPoolCreateInfo qpci{VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+		qpci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		qpci.queryCount = 2;
+		VK_ASSERT(vkd.vkCreateQueryPool(device, &qpci, allocator, &busy.queryPools[i]));
+	}
+	return busy;
+}
+
+void DestroyQueueBusy(const VulkanDeviceDispatch& vkd, VkDevice device, QueueBusy& busy)
+{
+	for(auto queryPool : busy.queryPools)
+		if(queryPool)
+			vkd.vkDestroyQueryPool(device, queryPool, allocator);
+}
+
+//First command of the command buffer, resets the queries in the command buffer itself
+void QueueBusyBegin(const VulkanDeviceDispatch& vkd, QueueBusy& busy, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if(!busy.enabled)
+		return;
+	vkd.vkCmdResetQueryPool(commandBuffer, busy.queryPools[frameIndex], 0, 2);
+	vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, busy.queryPools[frameIndex], 0);
+}
+
+//Last command of the command buffer
+void QueueBusyEnd(const VulkanDeviceDispatch& vkd, QueueBusy& busy, VkCommandBuffer commandBuffer, uint32_t frameIndex)
+{
+	if(!busy.enabled)
+		return;
+	vkd.vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, busy.queryPools[frameIndex], 1);
+	busy.pending[frameIndex] = true;
+}
+
+//Call once the submission of frameIndex is known to be complete
+void QueueBusyCollect(const VulkanDeviceDispatch& vkd, VkDevice device, QueueBusy& busy, uint32_t frameIndex)
+{
+	if(!busy.pending[frameIndex])
+		return;
+	busy.pending[frameIndex] = false;
+	uint64_t timestamps[2];
+	if(vkd.vkGetQueryPoolResults(device, busy.queryPools[frameIndex], 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS)
+		return;
+	//An interval the counter wrapped in is dropped
+	uint64_t begin = timestamps[0] & busy.timestampMask, end = timestamps[1] & busy.timestampMask;
+	if(end >= begin)
+		busy.intervals.push_back({begin, end});
+}
+
+//"GPU busy: graphics 2.10 ms/s, compute 0.52 ms/s, overlapped 0.31 ms/s", then restarts the sums
+int QueueBusySummary(QueueBusy& graphics, QueueBusy& compute, double seconds, TCHAR* buffer, size_t size)
+{
+	auto busyTicks = [](const std::vector<QueueBusyInterval>& intervals) -> uint64_t {
+		uint64_t ticks = 0;
+		for(auto& interval : intervals)
+			ticks += interval.end - interval.begin;
+		return ticks;
+	};
+	uint64_t graphicsTicks = busyTicks(graphics.intervals);
+	uint64_t computeTicks = busyTicks(compute.intervals);
+
+	//Overlap is what the union of both queues' intervals saves over their sum
+	std::vector<QueueBusyInterval> intervals = graphics.intervals;
+	intervals.insert(intervals.end(), compute.intervals.begin(), compute.intervals.end());
+	std::sort(intervals.begin(), intervals.end(), [](const QueueBusyInterval& a, const QueueBusyInterval& b) { return a.begin < b.begin; });
+	uint64_t unionTicks = 0, reached = 0;
+	for(auto& interval : intervals) {
+		uint64_t begin = std::max(interval.begin, reached);
+		if(interval.end > begin)
+			unionTicks += interval.end - begin;
+		reached = std::max(reached, interval.end);
+	}
+	uint64_t overlapTicks = graphicsTicks + computeTicks > unionTicks ? graphicsTicks + computeTicks - unionTicks : 0;
+
+	double scale = seconds > 0.0 ? graphics.timestampPeriod / 1e6 / seconds : 0.0;
+	int length = _stprintf_s(buffer, size, TEXT("GPU busy: graphics %.2f ms/s, compute %s"), graphicsTicks * scale, compute.enabled ? TEXT("") : TEXT("n/a"));
+	if(compute.enabled)
+		length += _stprintf_s(buffer + length, size - length, TEXT("%.2f ms/s, overlapped %.2f ms/s"), computeTicks * scale, overlapTicks * scale);
+	graphics.intervals.clear();
+	compute.intervals.clear();
+	return length;
+}
+
+//Bit scans, value must not be 0
+uint32_t HighestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+uint32_t LowestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward64(&index, value);
+	return index;
+#else
+	return __builtin_ctzll(value);
+#endif
+}
+
+//Device memory
+//Resources are sub-allocated from large vkAllocateMemory blocks, which keeps far below maxMemoryAllocationCount
+//and replaces a kernel call with a list lookup. The free ranges of every block are kept in TLSF size classes
+//(two-level segregated fit): a first level per power of two, split in TLSF_SL_COUNT linear second level classes,
+//with a bitmap per level, so allocating and freeing cost the same whatever the number of live allocations.
+//Each pool serves one memory type. When bufferImageGranularity is above 1, buffers and optimal tiling images get
+//separate pools so a linear and a non-linear resource never share a granularity page.
+//Not thread safe, allocations are made from the frame loop thread.
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT (1 << TLSF_SL_BITS)
+#define TLSF_FL_COUNT 48
+#define DEVICE_BLOCK_SIZE (64ull * 1024 * 1024) //at most an eighth of the heap, larger requests get their own allocation
+#define DEVICE_MIN_REGION 16 //smaller leftovers stay with the allocation instead of becoming free regions
+#define DEVICE_NONE UINT32_MAX
+
+enum class MemoryUsage {
+	GpuOnly, //device local, never mapped
+	Upload, //host visible and coherent, prefers system memory, written once and copied by the GPU
+	Dynamic, //host visible and coherent, prefers device local, rewritten every frame and read by the GPU
+	Readback, //host visible and coherent, prefers cached, written by the GPU and read on the host
+};
+
+struct DeviceRegion {
+	VkDeviceSize offset, size;
+	uint32_t block;
+	uint32_t prevPhysical, nextPhysical; //neighbours in the block, DEVICE_NONE at its ends
+	uint32_t prevFree, nextFree; //size class list, while free
+	bool free;
+};
+
+struct DeviceBlock {
+	VkDeviceMemory memory; //VK_NULL_HANDLE once released, the slot is reused
+	VkDeviceSize size;
+	uint8_t* mapped;
+};
+
+struct DevicePool {
+	uint32_t memoryTypeIndex;
+	std::vector<DeviceBlock> blocks;
+	uint32_t liveBlocks;
+	uint64_t firstLevelBitmap;
+	uint32_t secondLevelBitmaps[TLSF_FL_COUNT];
+	uint32_t freeHeads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+};
+
+struct DeviceAllocation {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint8_t* mapped; //at offset, null unless host visible
+	uint32_t pool; //DEVICE_NONE for a dedicated allocation
+	uint32_t region;
+	uint32_t memoryTypeIndex;
+};
+
+struct DeviceHeap {
+	VkDeviceSize blockBytes; //vkAllocateMemory total, blocks and dedicated
+	VkDeviceSize allocatedBytes; //handed out to resources
+	//Last VK_EXT_memory_budget query, blockBytes has changed by blockBytes - blockBytesAtBudget since
+	VkDeviceSize budget;
+	VkDeviceSize usage;
+	VkDeviceSize blockBytesAtBudget;
+};
+
+struct DeviceAllocator {
+	VkPhysicalDeviceMemoryProperties memoryProperties;
+	VkDeviceSize bufferImageGranularity;
+	bool memoryBudget;
+	std::vector<DevicePool> pools; //memory type * 2 + optimal tiling
+	std::vector<DeviceRegion> regions;
+	std::vector<uint32_t> unusedRegions;
+	DeviceHeap heaps[VK_MAX_MEMORY_HEAPS];
+	uint64_t allocationCount;
+	uint32_t deviceMemoryCount;
+};
+
+//Refreshes budgets from VK_EXT_memory_budget, or estimates them as 80% of the heap without it
+void DeviceAllocatorUpdateBudget(const VulkanInstanceDispatch& vki, VkPhysicalDevice physicalDevice, DeviceAllocator& deviceAllocator)
+{
+	VkPhysicalDeviceMemoryBudgetPropertiesEXT budget{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT};
+	VkPhysicalDeviceMemoryProperties2 memoryProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2, deviceAllocator.memoryBudget ? &budget : nullptr};
+	vki.vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties);
+	for(uint32_t i = 0; i < deviceAllocator.memoryProperties.memoryHeapCount; ++i) {
+		DeviceHeap& heap = deviceAllocator.heaps[i];
+		heap.budget = deviceAllocator.memoryBudget ? budget.heapBudget[i] : deviceAllocator.memoryProperties.memoryHeaps[i].size * 8 / 10;
+		heap.usage = deviceAllocator.memoryBudget ? budget.heapUsage[i] : heap.blockBytes;
+		heap.blockBytesAtBudget = heap.blockBytes;
+	}
+}
+
+DeviceAllocator CreateDeviceAllocator(const VulkanInstanceDispatch& vki, VkPhysicalDevice physicalDevice, bool memoryBudget)
+{
+	DeviceAllocator deviceAllocator{};
+	vki.vkGetPhysicalDeviceMemoryProperties(physicalDevice, &deviceAllocator.memoryProperties);
+	VkPhysicalDeviceProperties properties;
+	vki.vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	deviceAllocator.bufferImageGranularity = properties.limits.bufferImageGranularity;
+	deviceAllocator.memoryBudget = memoryBudget;
+	deviceAllocator.pools.resize(deviceAllocator.memoryProperties.memoryTypeCount * 2);
+	for(uint32_t i = 0; i < deviceAllocator.pools.size(); ++i) {
+		DevicePool& pool = deviceAllocator.pools[i];
+		pool.memoryTypeIndex = i / 2;
+		for(auto& heads : pool.freeHeads)
+			for(auto& head : heads)
+				head = DEVICE_NONE;
+	}
+	DeviceAllocatorUpdateBudget(vki, physicalDevice, deviceAllocator);
+	return deviceAllocator;
+}
+
+void DestroyDeviceAllocator(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator)
+{
+	ASSERT(deviceAllocator.allocationCount == 0 && "Device memory allocations are still alive");
+	for(auto& pool : deviceAllocator.pools)
+		for(auto& block : pool.blocks)
+			if(block.memory)
+				vkd.vkFreeMemory(device, block.memory, allocator);
+	deviceAllocator.pools.clear();
+	deviceAllocator.regions.clear();
+	deviceAllocator.unusedRegions.clear();
+	deviceAllocator.deviceMemoryCount = 0;
+}
+
+//Size class of a free region of size bytes
+void TlsfMapping(VkDeviceSize size, uint32_t* firstLevel, uint32_t* secondLevel)
+{
+	if(size < TLSF_SL_COUNT) {
+		*firstLevel = 0;
+		*secondLevel = static_cast<uint32_t>(size);
+		return;
+	}
+	uint32_t bit = HighestBit(size);
+	*firstLevel = bit - TLSF_SL_BITS + 1;
+	*secondLevel = static_cast<uint32_t>(size >> (bit - TLSF_SL_BITS)) - TLSF_SL_COUNT;
+	ASSERT(*firstLevel < TLSF_FL_COUNT);
+}
+
+void TlsfInsert(DeviceAllocator& deviceAllocator, DevicePool& pool, uint32_t index)
+{
+	DeviceRegion& region = deviceAllocator.regions[index];
+	uint32_t firstLevel, secondLevel;
+	TlsfMapping(region.size, &firstLevel, &secondLevel);
+	uint32_t& head = pool.freeHeads[firstLevel][secondLevel];
+	region.free = true;
+	region.prevFree = DEVICE_NONE;
+	region.nextFree = head;
+	if(head != DEVICE_NONE)
+		deviceAllocator.regions[head].prevFree = index;
+	head = index;
+	pool.firstLevelBitmap |= 1ull << firstLevel;
+	pool.secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
 }
 
-__declspec(noreturn) void VkAbort(VkResult result, LPCTSTR message)
+void TlsfRemove(DeviceAllocator& deviceAllocator, DevicePool& pool, uint32_t index)
+{
+	DeviceRegion& region = deviceAllocator.regions[index];
+	uint32_t firstLevel, secondLevel;
+	TlsfMapping(region.size, &firstLevel, &secondLevel);
+	if(region.prevFree != DEVICE_NONE)
+		deviceAllocator.regions[region.prevFree].nextFree = region.nextFree;
+	else {
+		pool.freeHeads[firstLevel][secondLevel] = region.nextFree;
+		if(region.nextFree == DEVICE_NONE) {
+			pool.secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+			if(!pool.secondLevelBitmaps[firstLevel])
+				pool.firstLevelBitmap &= ~(1ull << firstLevel);
+		}
+	}
+	if(region.nextFree != DEVICE_NONE)
+		deviceAllocator.regions[region.nextFree].prevFree = region.prevFree;
+	region.free = false;
+}
+
+//A free region of at least size bytes, DEVICE_NONE when the pool has none
+//The size is rounded up to the next class, so any region of the list found fits without walking it
+uint32_t TlsfFind(const DevicePool& pool, VkDeviceSize size)
+{
+	if(size >= TLSF_SL_COUNT)
+		size += (1ull << (HighestBit(size) - TLSF_SL_BITS)) - 1;
+	uint32_t firstLevel, secondLevel;
+	TlsfMapping(size, &firstLevel, &secondLevel);
+	if(firstLevel >= TLSF_FL_COUNT)
+		return DEVICE_NONE;
+
+	uint32_t secondLevelBitmap = pool.secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if(!secondLevelBitmap) {
+		uint64_t firstLevelBitmap = firstLevel + 1 < TLSF_FL_COUNT ? pool.firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if(!firstLevelBitmap)
+			return DEVICE_NONE;
+		firstLevel = LowestBit(firstLevelBitmap);
+		secondLevelBitmap = pool.secondLevelBitmaps[firstLevel];
+	}
+	return pool.freeHeads[firstLevel][LowestBit(secondLevelBitmap)];
+}
+
+uint32_t DeviceNewRegion(DeviceAllocator& deviceAllocator, VkDeviceSize offset, VkDeviceSize size, uint32_t block)
+{
+	uint32_t index;
+	if(deviceAllocator.unusedRegions.empty()) {
+		index = static_cast<uint32_t>(deviceAllocator.regions.size());
+		deviceAllocator.regions.emplace_back();
+	} else {
+		index = deviceAllocator.unusedRegions.back();
+		deviceAllocator.unusedRegions.pop_back();
+	}
+	deviceAllocator.regions[index] = {offset, size, block, DEVICE_NONE, DEVICE_NONE, DEVICE_NONE, DEVICE_NONE, false};
+	return index;
+}
+
+//Splits size bytes off the end of region index into a new free region
+void DeviceSplitRegion(DeviceAllocator& deviceAllocator, DevicePool& pool, uint32_t index, VkDeviceSize size)
+{
+	const DeviceRegion& region = deviceAllocator.regions[index];
+	uint32_t tail = DeviceNewRegion(deviceAllocator, region.offset + region.size - size, size, region.block);
+	DeviceRegion& fresh = deviceAllocator.regions[tail];
+	DeviceRegion& head = deviceAllocator.regions[index]; //regions may have moved
+	fresh.prevPhysical = index;
+	fresh.nextPhysical = head.nextPhysical;
+	if(head.nextPhysical != DEVICE_NONE)
+		deviceAllocator.regions[head.nextPhysical].prevPhysical = tail;
+	head.nextPhysical = tail;
+	head.size -= size;
+	TlsfInsert(deviceAllocator, pool, tail);
+}
+
+//Over budget heaps are skipped unless no other memory type can hold the block
+bool DeviceHeapHasRoom(const DeviceAllocator& deviceAllocator, uint32_t memoryTypeIndex, VkDeviceSize size)
+{
+	const DeviceHeap& heap = deviceAllocator.heaps[deviceAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+	return heap.usage + heap.blockBytes - heap.blockBytesAtBudget + size <= heap.budget;
+}
+
+VkDeviceMemory DeviceAllocateMemory(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, uint32_t memoryTypeIndex, VkDeviceSize size, uint8_t** mapped)
+{
+	VkMemoryAllocateInfo mai{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO};
+	mai.allocationSize = size;
+	mai.memoryTypeIndex = memoryTypeIndex;
+	VkDeviceMemory memory;
+	if(vkd.vkAllocateMemory(device, &mai, allocator, &memory) != VK_SUCCESS)
+		return VK_NULL_HANDLE;
+
+	*mapped = nullptr;
+	if(deviceAllocator.memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		VK_ASSERT(vkd.vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, reinterpret_cast<void**>(mapped)));
+	deviceAllocator.heaps[deviceAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].blockBytes += size;
+	++deviceAllocator.deviceMemoryCount;
+	return memory;
+}
+
+void DeviceFreeMemory(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, uint32_t memoryTypeIndex, VkDeviceMemory memory, VkDeviceSize size)
+{
+	vkd.vkFreeMemory(device, memory, allocator);
+	deviceAllocator.heaps[deviceAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].blockBytes -= size;
+	--deviceAllocator.deviceMemoryCount;
+}
+
+bool DevicePoolAllocate(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, uint32_t poolIndex, const VkMemoryRequirements& requirements, bool overBudget, DeviceAllocation* allocation)
+{
+	DevicePool& pool = deviceAllocator.pools[poolIndex];
+	VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+	uint32_t index = TlsfFind(pool, requirements.size + alignment - 1);
+	if(index == DEVICE_NONE) {
+		//New block, sized down on small heaps
+		VkDeviceSize blockSize = std::min<VkDeviceSize>(DEVICE_BLOCK_SIZE, deviceAllocator.memoryProperties.memoryHeaps[deviceAllocator.memoryProperties.memoryTypes[pool.memoryTypeIndex].heapIndex].size / 8);
+		if(!overBudget && !DeviceHeapHasRoom(deviceAllocator, pool.memoryTypeIndex, blockSize))
+			return false;
+		DeviceBlock block{};
+		block.size = blockSize;
+		block.memory = DeviceAllocateMemory(vkd, device, deviceAllocator, pool.memoryTypeIndex, blockSize, &block.mapped);
+		if(!block.memory)
+			return false;
+		uint32_t blockIndex = 0;
+		while(blockIndex < pool.blocks.size() && pool.blocks[blockIndex].memory)
+			++blockIndex;
+		if(blockIndex == pool.blocks.size())
+			pool.blocks.push_back(block);
+		else
+			pool.blocks[blockIndex] = block;
+		++pool.liveBlocks;
+		index = DeviceNewRegion(deviceAllocator, 0, blockSize, blockIndex);
+		TlsfInsert(deviceAllocator, pool, index);
+	}
+	TlsfRemove(deviceAllocator, pool, index);
+
+	//Leading padding up to the alignment goes back to the free lists, and so does the unused tail
+	DeviceRegion* region = &deviceAllocator.regions[index];
+	VkDeviceSize alignedOffset = (region->offset + alignment - 1) / alignment * alignment;
+	if(alignedOffset != region->offset) {
+		uint32_t padding = index;
+		DeviceSplitRegion(deviceAllocator, pool, padding, region->offset + region->size - alignedOffset);
+		index = deviceAllocator.regions[padding].nextPhysical;
+		TlsfRemove(deviceAllocator, pool, index);
+		TlsfInsert(deviceAllocator, pool, padding);
+		region = &deviceAllocator.regions[index];
+	}
+	if(region->size - requirements.size >= DEVICE_MIN_REGION)
+		DeviceSplitRegion(deviceAllocator, pool, index, region->size - requirements.size);
+
+	region = &deviceAllocator.regions[index];
+	DeviceBlock& block = pool.blocks[region->block];
+	*allocation = {block.memory, region->offset, requirements.size, block.mapped ? block.mapped + region->offset : nullptr, poolIndex, index, pool.memoryTypeIndex};
+	return true;
+}
+
+//Best memory type for the usage among memoryTypeBits, DEVICE_NONE when there is none
+uint32_t FindMemoryType(const VkPhysicalDeviceMemoryProperties& memoryProperties, uint32_t memoryTypeBits, MemoryUsage usage)
+{
+	VkMemoryPropertyFlags required = 0, preferred = 0, avoided = 0;
+	switch(usage) {
+		case MemoryUsage::GpuOnly:
+			preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+			break;
+		case MemoryUsage::Upload:
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+		case MemoryUsage::Dynamic:
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			break;
+		case MemoryUsage::Readback:
+			required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+			break;
+	}
+	auto bitCount = [](uint32_t bits) -> int { int count = 0; for(; bits; bits &= bits - 1) ++count; return count; };
+	uint32_t best = DEVICE_NONE;
+	int bestScore = INT_MIN;
+	for(uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+		VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+		if(!(memoryTypeBits & (1u << i)) || (flags & required) != required)
+			continue;
+		//Never picked, these need features the application does not enable
+		if(flags & (VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT | VK_MEMORY_PROPERTY_PROTECTED_BIT | VK_MEMORY_PROPERTY_DEVICE_COHERENT_BIT_AMD))
+			continue;
+		//Types are ordered by performance, the first of equal score wins
+		int score = bitCount(flags & preferred) - bitCount(flags & avoided);
+		if(score > bestScore) {
+			best = i;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+//optimalTiling is true for images with VK_IMAGE_TILING_OPTIMAL, false for buffers and linear images
+DeviceAllocation DeviceAllocate(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, const VkMemoryRequirements& requirements, MemoryUsage usage, bool optimalTiling)
+{
+	if(deviceAllocator.bufferImageGranularity <= 1)
+		optimalTiling = false;
+
+	//Memory types in order of preference, then again ignoring budgets as a last resort
+	for(int pass = 0; pass < 2; ++pass) {
+		bool overBudget = pass == 1;
+		uint32_t memoryTypeBits = requirements.memoryTypeBits;
+		uint32_t memoryTypeIndex;
+		while((memoryTypeIndex = FindMemoryType(deviceAllocator.memoryProperties, memoryTypeBits, usage)) != DEVICE_NONE) {
+			memoryTypeBits &= ~(1u << memoryTypeIndex);
+			DeviceAllocation allocation{};
+			VkDeviceSize heapSize = deviceAllocator.memoryProperties.memoryHeaps[deviceAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+			if(requirements.size > std::min<VkDeviceSize>(DEVICE_BLOCK_SIZE, heapSize / 8) / 2) {
+				//Dedicated, a block would be mostly this one resource
+				if(!overBudget && !DeviceHeapHasRoom(deviceAllocator, memoryTypeIndex, requirements.size))
+					continue;
+				allocation.memory = DeviceAllocateMemory(vkd, device, deviceAllocator, memoryTypeIndex, requirements.size, &allocation.mapped);
+				if(!allocation.memory)
+					continue;
+				allocation.size = requirements.size;
+				allocation.pool = allocation.region = DEVICE_NONE;
+				allocation.memoryTypeIndex = memoryTypeIndex;
+			} else if(!DevicePoolAllocate(vkd, device, deviceAllocator, memoryTypeIndex * 2 + (optimalTiling ? 1 : 0), requirements, overBudget, &allocation))
+				continue;
+
+			deviceAllocator.heaps[deviceAllocator.memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].allocatedBytes += allocation.size;
+			++deviceAllocator.allocationCount;
+			return allocation;
+		}
+	}
+	Abort(TEXT("Out of device memory"));
+}
+
+void DeviceFree(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, DeviceAllocation& allocation)
+{
+	if(!allocation.memory)
+		return;
+	deviceAllocator.heaps[deviceAllocator.memoryProperties.memoryTypes[allocation.memoryTypeIndex].heapIndex].allocatedBytes -= allocation.size;
+	--deviceAllocator.allocationCount;
+
+	if(allocation.pool == DEVICE_NONE) {
+		DeviceFreeMemory(vkd, device, deviceAllocator, allocation.memoryTypeIndex, allocation.memory, allocation.size);
+		allocation = {};
+		return;
+	}
+
+	//Merge with free neighbours
+	DevicePool& pool = deviceAllocator.pools[allocation.pool];
+	auto& regions = deviceAllocator.regions;
+	uint32_t index = allocation.region;
+	uint32_t next = regions[index].nextPhysical;
+	if(next != DEVICE_NONE && regions[next].free) {
+		TlsfRemove(deviceAllocator, pool, next);
+		regions[index].size += regions[next].size;
+		regions[index].nextPhysical = regions[next].nextPhysical;
+		if(regions[next].nextPhysical != DEVICE_NONE)
+			regions[regions[next].nextPhysical].prevPhysical = index;
+		deviceAllocator.unusedRegions.push_back(next);
+	}
+	uint32_t prev = regions[index].prevPhysical;
+	if(prev != DEVICE_NONE && regions[prev].free) {
+		TlsfRemove(deviceAllocator, pool, prev);
+		regions[prev].size += regions[index].size;
+		regions[prev].nextPhysical = regions[index].nextPhysical;
+		if(regions[index].nextPhysical != DEVICE_NONE)
+			regions[regions[index].nextPhysical].prevPhysical = prev;
+		deviceAllocator.unusedRegions.push_back(index);
+		index = prev;
+	}
+
+	//An empty block is released, unless it is the last one of its pool
+	DeviceRegion& region = regions[index];
+	if(region.prevPhysical == DEVICE_NONE && region.nextPhysical == DEVICE_NONE && pool.liveBlocks > 1) {
+		DeviceBlock& block = pool.blocks[region.block];
+		DeviceFreeMemory(vkd, device, deviceAllocator, pool.memoryTypeIndex, block.memory, block.size);
+		block = {};
+		--pool.liveBlocks;
+		deviceAllocator.unusedRegions.push_back(index);
+	} else
+		TlsfInsert(deviceAllocator, pool, index);
+	allocation = {};
+}
+
+void CreateBuffer(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, VkBuffer* buffer, DeviceAllocation* allocation)
+{
+	VkBufferCreateInfo bci{VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+	bci.size = size;
+	bci.usage = usage;
+	bci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	VK_ASSERT(vkd.vkCreateBuffer(device, &bci, allocator, buffer));
+
+	VkMemoryRequirements memoryRequirements;
+	vkd.vkGetBufferMemoryRequirements(device, *buffer, &memoryRequirements);
+	*allocation = DeviceAllocate(vkd, device, deviceAllocator, memoryRequirements, memoryUsage, false);
+	VK_ASSERT(vkd.vkBindBufferMemory(device, *buffer, allocation->memory, allocation->offset));
+}
+
+void DestroyBuffer(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, VkBuffer buffer, DeviceAllocation& allocation)
+{
+	vkd.vkDestroyBuffer(device, buffer, allocator);
+	DeviceFree(vkd, device, deviceAllocator, allocation);
+}
+
+//"Device memory: 3 allocations, 2 vkAllocateMemory, heap 0 1.5 / 6553.6 MB"
+int DeviceAllocatorSummary(const DeviceAllocator& deviceAllocator, TCHAR* buffer, size_t size)
+{
+	int length = _stprintf_s(buffer, size, TEXT("Device memory: %llu allocations, %u vkAllocateMemory"), static_cast<unsigned long long>(deviceAllocator.allocationCount), deviceAllocator.deviceMemoryCount);
+	for(uint32_t i = 0; i < deviceAllocator.memoryProperties.memoryHeapCount && length >= 0; ++i) {
+		const DeviceHeap& heap = deviceAllocator.heaps[i];
+		if(!heap.blockBytes)
+			continue;
+		int written = _stprintf_s(buffer + length, size - length, TEXT(", heap %u %.1f / %.1f MB"), i, (heap.usage + heap.blockBytes - heap.blockBytesAtBudget) / 1048576.0, heap.budget / 1048576.0);
+		if(written < 0)
+			break;
+		length += written;
+	}
+	return length;
+}
+
+//Shader registry
+//The shaders of shaders/ are SPIR-V assembly, assembled by GenerateShaders.py and embedded below, so
+//vkCreateShaderModule reads them straight from the executable. Run it after editing a shader. Each shader is known by
+//a hash of its file name computed at compile time, and gets one shader module that every pipeline using it shares.
+//BEGIN GENERATED SHADERS - GenerateShaders.py
+//shaders/fill.comp.spvasm
+alignas(64) constexpr uint32_t fillComp[] = {
+	0x07230203, 0x00010000, 0x00000000, 0x00000026, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+	0x00000000, 0x00000001, 0x0006000f, 0x00000005, 0x00000018, 0x6e69616d, 0x00000000, 0x00000009,
+	0x00060010, 0x00000018, 0x00000011, 0x00000008, 0x00000008, 0x00000001, 0x00040047, 0x00000009,
+	0x0000000b, 0x0000001c, 0x00040047, 0x0000000c, 0x00000022, 0x00000000, 0x00040047, 0x0000000c,
+	0x00000021, 0x00000000, 0x00030047, 0x0000000c, 0x00000019, 0x00030047, 0x0000000d, 0x00000002,
+	0x00050048, 0x0000000d, 0x00000000, 0x00000023, 0x00000000, 0x00050048, 0x0000000d, 0x00000001,
+	0x00000023, 0x00000010, 0x00020013, 0x00000001, 0x00030021, 0x00000002, 0x00000001, 0x00030016,
+	0x00000003, 0x00000020, 0x00040017, 0x00000004, 0x00000003, 0x00000004, 0x00040015, 0x00000005,
+	0x00000020, 0x00000000, 0x00040017, 0x00000006, 0x00000005, 0x00000002, 0x00040017, 0x00000007,
+	0x00000005, 0x00000003, 0x00040020, 0x00000008, 0x00000001, 0x00000007, 0x0004003b, 0x00000008,
+	0x00000009, 0x00000001, 0x00090019, 0x0000000a, 0x00000003, 0x00000001, 0x00000000, 0x00000000,
+	0x00000000, 0x00000002, 0x00000004, 0x00040020, 0x0000000b, 0x00000000, 0x0000000a, 0x0004003b,
+	0x0000000b, 0x0000000c, 0x00000000, 0x0004001e, 0x0000000d, 0x00000004, 0x00000006, 0x00040020,
+	0x0000000e, 0x00000009, 0x0000000d, 0x0004003b, 0x0000000e, 0x0000000f, 0x00000009, 0x00040015,
+	0x00000010, 0x00000020, 0x00000001, 0x00040017, 0x00000011, 0x00000010, 0x00000002, 0x0004002b,
+	0x00000010, 0x00000012, 0x00000000, 0x0004002b, 0x00000010, 0x00000013, 0x00000001, 0x00040020,
+	0x00000014, 0x00000009, 0x00000004, 0x00040020, 0x00000015, 0x00000009, 0x00000006, 0x00020014,
+	0x00000016, 0x00040017, 0x00000017, 0x00000016, 0x00000002, 0x00050036, 0x00000001, 0x00000018,
+	0x00000000, 0x00000002, 0x000200f8, 0x00000019, 0x0004003d, 0x00000007, 0x0000001a, 0x00000009,
+	0x0007004f, 0x00000006, 0x0000001b, 0x0000001a, 0x0000001a, 0x00000000, 0x00000001, 0x00050041,
+	0x00000015, 0x0000001c, 0x0000000f, 0x00000013, 0x0004003d, 0x00000006, 0x0000001d, 0x0000001c,
+	0x000500b0, 0x00000017, 0x0000001e, 0x0000001b, 0x0000001d, 0x0004009b, 0x00000016, 0x0000001f,
+	0x0000001e, 0x000300f7, 0x00000021, 0x00000000, 0x000400fa, 0x0000001f, 0x00000020, 0x00000021,
+	0x000200f8, 0x00000020, 0x0004003d, 0x0000000a, 0x00000022, 0x0000000c, 0x0004007c, 0x00000011,
+	0x00000023, 0x0000001b, 0x00050041, 0x00000014, 0x00000024, 0x0000000f, 0x00000012, 0x0004003d,
+	0x00000004, 0x00000025, 0x00000024, 0x00040063, 0x00000022, 0x00000023, 0x00000025, 0x000200f9,
+	0x00000021, 0x000200f8, 0x00000021, 0x000100fd, 0x00010038,
+};
+
+//shaders/overlay.frag.spvasm
+alignas(64) constexpr uint32_t overlayFrag[] = {
+	0x07230203, 0x00010000, 0x00000000, 0x0000001a, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+	0x00000000, 0x00000001, 0x0008000f, 0x00000004, 0x00000010, 0x6e69616d, 0x00000000, 0x0000000d,
+	0x0000000e, 0x0000000f, 0x00030010, 0x00000010, 0x00000007, 0x00040047, 0x00000009, 0x00000022,
+	0x00000000, 0x00040047, 0x00000009, 0x00000021, 0x00000000, 0x00040047, 0x0000000d, 0x0000001e,
+	0x00000000, 0x00040047, 0x0000000e, 0x0000001e, 0x00000001, 0x00040047, 0x0000000f, 0x0000001e,
+	0x00000000, 0x00020013, 0x00000001, 0x00030021, 0x00000002, 0x00000001, 0x00030016, 0x00000003,
+	0x00000020, 0x00040017, 0x00000004, 0x00000003, 0x00000002, 0x00040017, 0x00000005, 0x00000003,
+	0x00000004, 0x00090019, 0x00000006, 0x00000003, 0x00000001, 0x00000000, 0x00000000, 0x00000000,
+	0x00000001, 0x00000000, 0x0003001b, 0x00000007, 0x00000006, 0x00040020, 0x00000008, 0x00000000,
+	0x00000007, 0x0004003b, 0x00000008, 0x00000009, 0x00000000, 0x00040020, 0x0000000a, 0x00000001,
+	0x00000004, 0x00040020, 0x0000000b, 0x00000001, 0x00000005, 0x00040020, 0x0000000c, 0x00000003,
+	0x00000005, 0x0004003b, 0x0000000a, 0x0000000d, 0x00000001, 0x0004003b, 0x0000000b, 0x0000000e,
+	0x00000001, 0x0004003b, 0x0000000c, 0x0000000f, 0x00000003, 0x00050036, 0x00000001, 0x00000010,
+	0x00000000, 0x00000002, 0x000200f8, 0x00000011, 0x0004003d, 0x00000007, 0x00000012, 0x00000009,
+	0x0004003d, 0x00000004, 0x00000013, 0x0000000d, 0x00050057, 0x00000005, 0x00000014, 0x00000012,
+	0x00000013, 0x00050051, 0x00000003, 0x00000015, 0x00000014, 0x00000000, 0x0004003d, 0x00000005,
+	0x00000016, 0x0000000e, 0x00050051, 0x00000003, 0x00000017, 0x00000016, 0x00000003, 0x00050085,
+	0x00000003, 0x00000018, 0x00000017, 0x00000015, 0x00060052, 0x00000005, 0x00000019, 0x00000018,
+	0x00000016, 0x00000003, 0x0003003e, 0x0000000f, 0x00000019, 0x000100fd, 0x00010038,
+};
+
+//shaders/overlay.vert.spvasm
+alignas(64) constexpr uint32_t overlayVert[] = {
+	0x07230203, 0x00010000, 0x00000000, 0x0000001a, 0x00000000, 0x00020011, 0x00000001, 0x0003000e,
+	0x00000000, 0x00000001, 0x000b000f, 0x00000000, 0x00000012, 0x6e69616d, 0x00000000, 0x0000000a,
+	0x0000000b, 0x0000000c, 0x0000000d, 0x0000000e, 0x0000000f, 0x00040047, 0x0000000a, 0x0000001e,
+	0x00000000, 0x00040047, 0x0000000b, 0x0000001e, 0x00000001, 0x00040047, 0x0000000c, 0x0000001e,
+	0x00000002, 0x00040047, 0x0000000d, 0x0000001e, 0x00000000, 0x00040047, 0x0000000e, 0x0000001e,
+	0x00000001, 0x00040047, 0x0000000f, 0x0000000b, 0x00000000, 0x00020013, 0x00000001, 0x00030021,
+	0x00000002, 0x00000001, 0x00030016, 0x00000003, 0x00000020, 0x00040017, 0x00000004, 0x00000003,
+	0x00000002, 0x00040017, 0x00000005, 0x00000003, 0x00000004, 0x00040020, 0x00000006, 0x00000001,
+	0x00000004, 0x00040020, 0x00000007, 0x00000001, 0x00000005, 0x00040020, 0x00000008, 0x00000003,
+	0x00000004, 0x00040020, 0x00000009, 0x00000003, 0x00000005, 0x0004003b, 0x00000006, 0x0000000a,
+	0x00000001, 0x0004003b, 0x00000006, 0x0000000b, 0x00000001, 0x0004003b, 0x00000007, 0x0000000c,
+	0x00000001, 0x0004003b, 0x00000008, 0x0000000d, 0x00000003, 0x0004003b, 0x00000009, 0x0000000e,
+	0x00000003, 0x0004003b, 0x00000009, 0x0000000f, 0x00000003, 0x0004002b, 0x00000003, 0x00000010,
+	0x00000000, 0x0004002b, 0x00000003, 0x00000011, 0x3f800000, 0x00050036, 0x00000001, 0x00000012,
+	0x00000000, 0x00000002, 0x000200f8, 0x00000013, 0x0004003d, 0x00000004, 0x00000014, 0x0000000a,
+	0x00050051, 0x00000003, 0x00000015, 0x00000014, 0x00000000, 0x00050051, 0x00000003, 0x00000016,
+	0x00000014, 0x00000001, 0x00070050, 0x00000005, 0x00000017, 0x00000015, 0x00000016, 0x00000010,
+	0x00000011, 0x0003003e, 0x0000000f, 0x00000017, 0x0004003d, 0x00000004, 0x00000018, 0x0000000b,
+	0x0003003e, 0x0000000d, 0x00000018, 0x0004003d, 0x00000005, 0x00000019, 0x0000000c, 0x0003003e,
+	0x0000000e, 0x00000019, 0x000100fd, 0x00010038,
+};
+
+#define SHADER_BINARIES(X) \
+	X("fill.comp", fillComp) \
+	X("overlay.frag", overlayFrag) \
+	X("overlay.vert", overlayVert) \
+
+//END GENERATED SHADERS
+
+//FNV-1a of the file name
+constexpr uint32_t ShaderHash(const char* name)
+{
+	uint32_t hash = 2166136261u;
+	while(*name)
+		hash = (hash ^ static_cast<uint8_t>(*name++)) * 16777619u;
+	return hash;
+}
+
+struct ShaderBinary {
+	uint32_t key;
+	const uint32_t* code;
+	size_t size; //bytes
+};
+
+#define SHADER_BINARY(name, code) {ShaderHash(name), code, sizeof(code)},
+constexpr ShaderBinary shaderBinaries[] = {SHADER_BINARIES(SHADER_BINARY)};
+#undef SHADER_BINARY
+constexpr uint32_t SHADER_COUNT = sizeof(shaderBinaries) / sizeof(shaderBinaries[0]);
+
+//SHADER_COUNT when no shader has key
+constexpr uint32_t ShaderIndex(uint32_t key)
+{
+	for(uint32_t i = 0; i < SHADER_COUNT; ++i) {
+		if(shaderBinaries[i].key == key)
+			return i;
+	}
+	return SHADER_COUNT;
+}
+
+constexpr bool ShaderKeysUnique()
+{
+	for(uint32_t i = 0; i < SHADER_COUNT; ++i) {
+		if(ShaderIndex(shaderBinaries[i].key) != i)
+			return false;
+	}
+	return true;
+}
+static_assert(ShaderKeysUnique(), "Two shader file names have the same hash, rename one");
+
+template<uint32_t index>
+constexpr uint32_t ShaderCheck()
+{
+	static_assert(index < SHADER_COUNT, "The shader is not embedded, add it to shaders/ and run GenerateShaders.py");
+	return index;
+}
+
+//Index of an embedded shader in ShaderModules, resolved at compile time
+#define SHADER(name) ShaderCheck<ShaderIndex(ShaderHash(name))>()
+
+struct ShaderModules {
+	VkShaderModule modules[SHADER_COUNT];
+};
+
+//Every embedded shader, created before any pipeline so that threads creating pipelines only read the table
+ShaderModules CreateShaderModules(const VulkanDeviceDispatch& vkd, VkDevice device)
+{
+	ShaderModules shaderModules;
+	for(uint32_t i = 0; i < SHADER_COUNT; ++i) {
+		VkShaderModuleCreateInfo smci{VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO};
+		smci.codeSize = shaderBinaries[i].size;
+		smci.pCode = shaderBinaries[i].code;
+		VK_ASSERT(vkd.vkCreateShaderModule(device, &smci, allocator, &shaderModules.modules[i]));
+	}
+	return shaderModules;
+}
+
+void DestroyShaderModules(const VulkanDeviceDispatch& vkd, VkDevice device, ShaderModules& shaderModules)
+{
+	for(auto shaderModule : shaderModules.modules)
+		vkd.vkDestroyShaderModule(device, shaderModule, allocator);
+}
+
+//Statistics overlay
+//A 5x7 bitmap font in 6x8 cells of a 16x6 R8 atlas, uploaded once. Text is laid out on the CPU as
+//textured quads into a persistently mapped vertex buffer, one slice per frame in flight, and drawn
+//with a single vkCmdDraw in a render pass that loads the cleared image.
+#define OVERLAY_GLYPH_WIDTH 5
+#define OVERLAY_GLYPH_HEIGHT 7
+#define OVERLAY_CELL_WIDTH 6
+#define OVERLAY_CELL_HEIGHT 8
+#define OVERLAY_ATLAS_COLUMNS 16
+#define OVERLAY_ATLAS_ROWS 6
+#define OVERLAY_ATLAS_WIDTH (OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_WIDTH)
+#define OVERLAY_ATLAS_HEIGHT (OVERLAY_ATLAS_ROWS * OVERLAY_CELL_HEIGHT)
+#define OVERLAY_FIRST_CHAR 32
+#define OVERLAY_BLOCK_GLYPH 95
+#define OVERLAY_SCALE 2 //screen pixels per font pixel
+#define OVERLAY_MARGIN 4 //font pixels around the text
+#define OVERLAY_MAX_QUADS 2048
+#define OVERLAY_MAX_VERTICES (OVERLAY_MAX_QUADS * 6)
+
+//One byte per row, bit 4 is the leftmost column. Printable ASCII, then a solid block.
+const uint8_t overlayFont[OVERLAY_BLOCK_GLYPH + 1][OVERLAY_GLYPH_HEIGHT] = {
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, //space
+	0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04, //!
+	0x0A, 0x0A, 0x00, 0x00, 0x00, 0x00, 0x00, //"
+	0x0A, 0x0A, 0x1F, 0x0A, 0x1F, 0x0A, 0x0A, //#
+	0x04, 0x0F, 0x14, 0x0E, 0x05, 0x1E, 0x04, //$
+	0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03, //%
+	0x0C, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0D, //&
+	0x04, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, //'
+	0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02, //(
+	0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08, //)
+	0x00, 0x04, 0x15, 0x0E, 0x15, 0x04, 0x00, //*
+	0x00, 0x04, 0x04, 0x1F, 0x04, 0x04, 0x00, //+
+	0x00, 0x00, 0x00, 0x00, 0x0C, 0x04, 0x08, //,
+	0x00, 0x00, 0x00, 0x1F, 0x00, 0x00, 0x00, //-
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x0C, 0x0C, //.
+	0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00, ///
+	0x0E, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0E, //0
+	0x04, 0x0C, 0x04, 0x04, 0x04, 0x04, 0x0E, //1
+	0x0E, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1F, //2
+	0x1F, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0E, //3
+	0x02, 0x06, 0x0A, 0x12, 0x1F, 0x02, 0x02, //4
+	0x1F, 0x10, 0x1E, 0x01, 0x01, 0x11, 0x0E, //5
+	0x06, 0x08, 0x10, 0x1E, 0x11, 0x11, 0x0E, //6
+	0x1F, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08, //7
+	0x0E, 0x11, 0x11, 0x0E, 0x11, 0x11, 0x0E, //8
+	0x0E, 0x11, 0x11, 0x0F, 0x01, 0x02, 0x0C, //9
+	0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x0C, 0x00, //:
+	0x00, 0x0C, 0x0C, 0x00, 0x0C, 0x04, 0x08, //;
+	0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02, //<
+	0x00, 0x00, 0x1F, 0x00, 0x1F, 0x00, 0x00, //=
+	0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08, //>
+	0x0E, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04, //?
+	0x0E, 0x11, 0x01, 0x0D, 0x15, 0x15, 0x0E, //@
+	0x0E, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11, //A
+	0x1E, 0x11, 0x11, 0x1E, 0x11, 0x11, 0x1E, //B
+	0x0E, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0E, //C
+	0x1C, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1C, //D
+	0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x1F, //E
+	0x1F, 0x10, 0x10, 0x1E, 0x10, 0x10, 0x10, //F
+	0x0E, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0F, //G
+	0x11, 0x11, 0x11, 0x1F, 0x11, 0x11, 0x11, //H
+	0x0E, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E, //I
+	0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0C, //J
+	0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11, //K
+	0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1F, //L
+	0x11, 0x1B, 0x15, 0x15, 0x11, 0x11, 0x11, //M
+	0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11, //N
+	0x0E, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E, //O
+	0x1E, 0x11, 0x11, 0x1E, 0x10, 0x10, 0x10, //P
+	0x0E, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0D, //Q
+	0x1E, 0x11, 0x11, 0x1E, 0x14, 0x12, 0x11, //R
+	0x0F, 0x10, 0x10, 0x0E, 0x01, 0x01, 0x1E, //S
+	0x1F, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, //T
+	0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0E, //U
+	0x11, 0x11, 0x11, 0x11, 0x11, 0x0A, 0x04, //V
+	0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0A, //W
+	0x11, 0x11, 0x0A, 0x04, 0x0A, 0x11, 0x11, //X
+	0x11, 0x11, 0x0A, 0x04, 0x04, 0x04, 0x04, //Y
+	0x1F, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1F, //Z
+	0x0E, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0E, //[
+	0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00, //backslash
+	0x0E, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0E, //]
+	0x04, 0x0A, 0x11, 0x00, 0x00, 0x00, 0x00, //^
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, //_
+	0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, //`
+	0x00, 0x00, 0x0E, 0x01, 0x0F, 0x11, 0x0F, //a
+	0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1E, //b
+	0x00, 0x00, 0x0E, 0x10, 0x10, 0x11, 0x0E, //c
+	0x01, 0x01, 0x0D, 0x13, 0x11, 0x11, 0x0F, //d
+	0x00, 0x00, 0x0E, 0x11, 0x1F, 0x10, 0x0E, //e
+	0x06, 0x09, 0x08, 0x1C, 0x08, 0x08, 0x08, //f
+	0x00, 0x0F, 0x11, 0x11, 0x0F, 0x01, 0x0E, //g
+	0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11, //h
+	0x04, 0x00, 0x0C, 0x04, 0x04, 0x04, 0x0E, //i
+	0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0C, //j
+	0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12, //k
+	0x0C, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0E, //l
+	0x00, 0x00, 0x1A, 0x15, 0x15, 0x11, 0x11, //m
+	0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11, //n
+	0x00, 0x00, 0x0E, 0x11, 0x11, 0x11, 0x0E, //o
+	0x00, 0x00, 0x1E, 0x11, 0x1E, 0x10, 0x10, //p
+	0x00, 0x00, 0x0D, 0x13, 0x0F, 0x01, 0x01, //q
+	0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10, //r
+	0x00, 0x00, 0x0E, 0x10, 0x0E, 0x01, 0x1E, //s
+	0x08, 0x08, 0x1C, 0x08, 0x08, 0x09, 0x06, //t
+	0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0D, //u
+	0x00, 0x00, 0x11, 0x11, 0x11, 0x0A, 0x04, //v
+	0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0A, //w
+	0x00, 0x00, 0x11, 0x0A, 0x04, 0x0A, 0x11, //x
+	0x00, 0x00, 0x11, 0x11, 0x0F, 0x01, 0x0E, //y
+	0x00, 0x00, 0x1F, 0x02, 0x04, 0x08, 0x1F, //z
+	0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02, //{
+	0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, //|
+	0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08, //}
+	0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00, //~
+	0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, 0x1F, //block, overlay background
+};
+
+struct OverlayVertex {
+	float x, y; //normalized device coordinates
+	float u, v;
+	uint32_t color; //R8G8B8A8_UNORM, red in the low byte
+};
+
+//Fills the R8 atlas, OVERLAY_ATLAS_WIDTH * OVERLAY_ATLAS_HEIGHT bytes
+void OverlayAtlasPixels(uint8_t* pixels)
+{
+	memset(pixels, 0, OVERLAY_ATLAS_WIDTH * OVERLAY_ATLAS_HEIGHT);
+	for(uint32_t glyph = 0; glyph <= OVERLAY_BLOCK_GLYPH; ++glyph) {
+		uint32_t x0 = glyph % OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_WIDTH;
+		uint32_t y0 = glyph / OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_HEIGHT;
+		for(uint32_t y = 0; y < OVERLAY_GLYPH_HEIGHT; ++y)
+			for(uint32_t x = 0; x < OVERLAY_GLYPH_WIDTH; ++x)
+				if(overlayFont[glyph][y] & (0x10 >> x))
+					pixels[(y0 + y) * OVERLAY_ATLAS_WIDTH + x0 + x] = 0xFF;
+	}
+}
+
+//Pixel rectangle x0,y0 - x1,y1 textured with atlas texel rectangle s0,t0 - s1,t1
+void OverlayQuad(OverlayVertex* vertices, VkExtent2D extent, int x0, int y0, int x1, int y1, uint32_t s0, uint32_t t0, uint32_t s1, uint32_t t1, uint32_t color)
+{
+	float left = x0 * 2.0f / extent.width - 1.0f, right = x1 * 2.0f / extent.width - 1.0f;
+	float top = y0 * 2.0f / extent.height - 1.0f, bottom = y1 * 2.0f / extent.height - 1.0f;
+	float u0 = static_cast<float>(s0) / OVERLAY_ATLAS_WIDTH, u1 = static_cast<float>(s1) / OVERLAY_ATLAS_WIDTH;
+	float v0 = static_cast<float>(t0) / OVERLAY_ATLAS_HEIGHT, v1 = static_cast<float>(t1) / OVERLAY_ATLAS_HEIGHT;
+	vertices[0] = {left, top, u0, v0, color};
+	vertices[1] = {right, top, u1, v0, color};
+	vertices[2] = {left, bottom, u0, v1, color};
+	vertices[3] = {left, bottom, u0, v1, color};
+	vertices[4] = {right, top, u1, v0, color};
+	vertices[5] = {right, bottom, u1, v1, color};
+}
+
+//Lays out text, lines separated by '\n', at the top left corner over a translucent background
+//Returns the vertex count, at most OVERLAY_MAX_VERTICES
+uint32_t OverlayBuild(OverlayVertex* vertices, VkExtent2D extent, LPCTSTR text)
+{
+	const int cellWidth = OVERLAY_CELL_WIDTH * OVERLAY_SCALE;
+	const int lineHeight = (OVERLAY_CELL_HEIGHT + 1) * OVERLAY_SCALE;
+	const int margin = OVERLAY_MARGIN * OVERLAY_SCALE;
+
+	int columns = 0, lines = 0;
+	for(LPCTSTR c = text; *c; ++lines) {
+		int length = 0;
+		for(; *c && *c != '\n'; ++c)
+			++length;
+		if(*c)
+			++c;
+		columns = std::max(columns, length);
+	}
+	if(!columns)
+		return 0;
+
+	//The block glyph is solid, any texel inside it gives full coverage
+	uint32_t blockS = OVERLAY_BLOCK_GLYPH % OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_WIDTH + OVERLAY_GLYPH_WIDTH / 2;
+	uint32_t blockT = OVERLAY_BLOCK_GLYPH / OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_HEIGHT + OVERLAY_GLYPH_HEIGHT / 2;
+	OverlayQuad(vertices, extent, 0, 0, columns * cellWidth + margin * 2, lines * lineHeight + margin * 2, blockS, blockT, blockS, blockT, 0xB0000000);
+	uint32_t quadCount = 1;
+
+	int x = margin, y = margin;
+	for(LPCTSTR c = text; *c && quadCount < OVERLAY_MAX_QUADS; ++c) {
+		if(*c == '\n') {
+			x = margin;
+			y += lineHeight;
+			continue;
+		}
+		if(*c != ' ') {
+			uint32_t glyph = *c > OVERLAY_FIRST_CHAR && *c < OVERLAY_FIRST_CHAR + OVERLAY_BLOCK_GLYPH ? *c - OVERLAY_FIRST_CHAR : '?' - OVERLAY_FIRST_CHAR;
+			uint32_t s = glyph % OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_WIDTH;
+			uint32_t t = glyph / OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_HEIGHT;
+			OverlayQuad(vertices + quadCount * 6, extent, x, y, x + OVERLAY_GLYPH_WIDTH * OVERLAY_SCALE, y + OVERLAY_GLYPH_HEIGHT * OVERLAY_SCALE, s, t, s + OVERLAY_GLYPH_WIDTH, t + OVERLAY_GLYPH_HEIGHT, 0xFFFFFFFF);
+			++quadCount;
+		}
+		x += cellWidth;
+	}
+
+	return quadCount * 6;
+}
+
+//Stand-in for the draws of a scene, drawCount translucent quads tiled over the whole image, one vkCmdDraw each
+//Laid out in normalized device coordinates, so the vertices do not depend on the extent and are uploaded once
+#define SCENE_MAX_DRAWS 32768
+void SceneBuild(OverlayVertex* vertices, uint32_t drawCount)
+{
+	uint32_t columns = 1;
+	while(columns * columns < drawCount)
+		++columns;
+	uint32_t rows = (drawCount + columns - 1) / columns;
+	uint32_t blockS = OVERLAY_BLOCK_GLYPH % OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_WIDTH + OVERLAY_GLYPH_WIDTH / 2;
+	uint32_t blockT = OVERLAY_BLOCK_GLYPH / OVERLAY_ATLAS_COLUMNS * OVERLAY_CELL_HEIGHT + OVERLAY_GLYPH_HEIGHT / 2;
+	float u = static_cast<float>(blockS) / OVERLAY_ATLAS_WIDTH, v = static_cast<float>(blockT) / OVERLAY_ATLAS_HEIGHT;
+	float width = 2.0f / columns, height = 2.0f / rows;
+	for(uint32_t i = 0; i < drawCount; ++i) {
+		float left = -1.0f + i % columns * width, top = -1.0f + i / columns * height;
+		float right = left + width * 0.8f, bottom = top + height * 0.8f;
+		uint32_t color = 0x60000000 | (i * 0x9E3779B9u >> 8 & 0x00FFFFFF);
+		OverlayVertex* quad = vertices + i * 6;
+		quad[0] = {left, top, u, v, color};
+		quad[1] = {right, top, u, v, color};
+		quad[2] = {left, bottom, u, v, color};
+		quad[3] = {left, bottom, u, v, color};
+		quad[4] = {right, top, u, v, color};
+		quad[5] = {right, bottom, u, v, color};
+	}
+}
+
+[[noreturn]] void Abort(LPCTSTR message)
+{
+	TCERR << message << std::endl;
+	ExitProcess(1);
+}
+
+#ifdef _WIN32
+[[noreturn]] void Win32Abort(LPCTSTR message)
+{
+	DWORD last_error = GetLastError();
+	LPTSTR buffer;
+	DWORD size_in_tchar = FormatMessage(FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM, 0, last_error, 0, (LPTSTR)&buffer, 0, 0);
+
+	if(size_in_tchar) {
+		TCERR << message << std::endl
+		      << buffer << "std::endl";
+		LocalFree(buffer);
+	}
+
+	ExitProcess(last_error);
+}
+#else
+[[noreturn]] void DlAbort(LPCTSTR message)
+{
+	const char* error = dlerror();
+	TCERR << message << std::endl;
+	if(error)
+		TCERR << error << std::endl;
+	ExitProcess(1);
+}
+#endif
+
+[[noreturn]] void VkAbort(VkResult result, LPCTSTR message)
+{
+	TCERR << TEXT("Vulkan operation failed") << std::endl;
+	TCERR << message << std::endl;
+	ExitProcess(result);
+}
+
+//HOST_TIME_DOMAIN is the clock of GetTickNanoseconds, as VK_EXT_calibrated_timestamps names it
+#ifdef _WIN32
+#define HOST_TIME_DOMAIN VK_TIME_DOMAIN_QUERY_PERFORMANCE_COUNTER_EXT
+
+//Converts a QueryPerformanceCounter value to nanoseconds
+int64_t HostTicksToNanoseconds(int64_t counter)
+{
+	static LARGE_INTEGER frequency;
+
+	if(!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency); //counts per second
+
+	//Split in whole seconds and remainder, counter * 1e9 overflows after a few hours of uptime
+	auto seconds = counter / frequency.QuadPart;
+	auto remainder = counter % frequency.QuadPart;
+	return seconds * 1000000000 + remainder * 1000000000 / frequency.QuadPart;
+}
+
+int64_t GetTickNanoseconds()
+{
+	LARGE_INTEGER counter;
+	QueryPerformanceCounter(&counter);
+	return HostTicksToNanoseconds(counter.QuadPart);
+}
+#else
+#define HOST_TIME_DOMAIN VK_TIME_DOMAIN_CLOCK_MONOTONIC_EXT
+
+//CLOCK_MONOTONIC already counts nanoseconds
+int64_t HostTicksToNanoseconds(int64_t counter)
+{
+	return counter;
+}
+
+//CLOCK_MONOTONIC is served from the vDSO, reading it does not enter the kernel
+int64_t GetTickNanoseconds()
+{
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+#endif
+
+//Log-linear histogram of nanosecond durations
+//Values below 16 ns get a bucket each, every power of two above is split in 16 linear sub-buckets,
+//so any recorded value is off by at most 1/16 (6.25%) whatever its magnitude.
+//Recording is lock-free, percentiles can be queried from any thread while the loop records.
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_BUCKETS (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS)
+
+struct Histogram {
+	std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS];
+	std::atomic<uint64_t> count;
+	std::atomic<uint64_t> sum;
+	std::atomic<uint64_t> max;
+};
+
+uint32_t HistogramBucket(uint64_t value)
+{
+	if(value < HISTOGRAM_SUB_BUCKETS)
+		return static_cast<uint32_t>(value);
+	auto bit = HighestBit(value);
+	auto sub = static_cast<uint32_t>(value >> (bit - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1);
+	return (bit - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+//Highest value that lands in the bucket, percentiles never under-report
+uint64_t HistogramBucketValue(uint32_t bucket)
+{
+	if(bucket < HISTOGRAM_SUB_BUCKETS)
+		return bucket;
+	auto bit = bucket / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+	auto sub = static_cast<uint64_t>(bucket % HISTOGRAM_SUB_BUCKETS);
+	auto shift = bit - HISTOGRAM_SUB_BITS;
+	return ((HISTOGRAM_SUB_BUCKETS + sub + 1) << shift) - 1;
+}
+
+void HistogramRecord(Histogram& histogram, int64_t nanoseconds)
+{
+	auto value = static_cast<uint64_t>(std::max<int64_t>(nanoseconds, 0));
+	histogram.buckets[HistogramBucket(value)].fetch_add(1, std::memory_order_relaxed);
+	histogram.sum.fetch_add(value, std::memory_order_relaxed);
+	auto max = histogram.max.load(std::memory_order_relaxed);
+	while(value > max && !histogram.max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+		;
+	//Published last, a reader never sees a count the buckets do not add up to
+	histogram.count.fetch_add(1, std::memory_order_release);
+}
+
+void HistogramReset(Histogram& histogram)
+{
+	for(auto& bucket : histogram.buckets)
+		bucket.store(0, std::memory_order_relaxed);
+	histogram.sum.store(0, std::memory_order_relaxed);
+	histogram.max.store(0, std::memory_order_relaxed);
+	histogram.count.store(0, std::memory_order_release);
+}
+
+//percentile in [0, 1], returns nanoseconds
+uint64_t HistogramPercentile(const Histogram& histogram, double percentile)
+{
+	auto count = histogram.count.load(std::memory_order_acquire);
+	if(!count)
+		return 0;
+	auto rank = std::max<uint64_t>(static_cast<uint64_t>(percentile * count + 0.5), 1);
+	uint64_t seen = 0;
+	for(uint32_t i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		seen += histogram.buckets[i].load(std::memory_order_relaxed);
+		if(seen >= rank)
+			return std::min(HistogramBucketValue(i), histogram.max.load(std::memory_order_relaxed));
+	}
+	return histogram.max.load(std::memory_order_relaxed);
+}
+
+uint64_t HistogramMean(const Histogram& histogram)
+{
+	auto count = histogram.count.load(std::memory_order_acquire);
+	return count ? histogram.sum.load(std::memory_order_relaxed) / count : 0;
+}
+
+//"p50 16.667 p90 16.702 p99 17.010 max 33.4 ms (n 1234)"
+int HistogramSummary(const Histogram& histogram, TCHAR* buffer, size_t size)
+{
+	return _stprintf_s(buffer, size, TEXT("p50 %.3f p90 %.3f p99 %.3f max %.3f ms (n %llu)"),
+		HistogramPercentile(histogram, 0.50) / 1e6, HistogramPercentile(histogram, 0.90) / 1e6,
+		HistogramPercentile(histogram, 0.99) / 1e6, histogram.max.load(std::memory_order_relaxed) / 1e6,
+		static_cast<unsigned long long>(histogram.count.load(std::memory_order_acquire)));
+}
+
+//Per frame CPU timings of the render loop
+struct FrameStats {
+	Histogram frameTime; //acquire to acquire, what the user sees
+	Histogram frameWait; //blocked on the timeline for a free frame context
+	Histogram acquire; //blocked in vkAcquireNextImageKHR
+	Histogram record; //command buffer recording, overlay layout included
+	Histogram submit; //vkQueueSubmit
+	Histogram present; //blocked in vkQueuePresentKHR
+};
+
+#define FRAME_STATS_ROWS 6
+
+struct FrameStatsRow {
+	LPCTSTR name; //for display
+	LPCTSTR key; //for reports
+	const Histogram* histogram;
+};
+
+void GetFrameStatsRows(const FrameStats& stats, FrameStatsRow (&rows)[FRAME_STATS_ROWS])
+{
+	rows[0] = {TEXT("Frame time"), TEXT("frame_time"), &stats.frameTime};
+	rows[1] = {TEXT("Frame wait"), TEXT("frame_wait"), &stats.frameWait};
+	rows[2] = {TEXT("Acquire"), TEXT("acquire"), &stats.acquire};
+	rows[3] = {TEXT("Record"), TEXT("record"), &stats.record};
+	rows[4] = {TEXT("Submit"), TEXT("submit"), &stats.submit};
+	rows[5] = {TEXT("Present"), TEXT("present"), &stats.present};
+}
+
+void FrameStatsReset(FrameStats& stats)
+{
+	HistogramReset(stats.frameTime);
+	HistogramReset(stats.frameWait);
+	HistogramReset(stats.acquire);
+	HistogramReset(stats.record);
+	HistogramReset(stats.submit);
+	HistogramReset(stats.present);
+}
+
+//One line per histogram, "Frame time: p50 ... ms (n ...)\n"
+int FrameStatsSummary(const FrameStats& stats, TCHAR* buffer, size_t size)
+{
+	FrameStatsRow rows[FRAME_STATS_ROWS];
+	GetFrameStatsRows(stats, rows);
+	int length = 0;
+	for(auto& row : rows) {
+		length += _stprintf_s(buffer + length, size - length, TEXT("%s: "), row.name);
+		length += HistogramSummary(*row.histogram, buffer + length, size - length);
+		length += _stprintf_s(buffer + length, size - length, TEXT("\n"));
+	}
+	return length;
+}
+
+//Resource state tracker
+//Knows the layout of each tracked resource and the stages and accesses of its last uses, and computes the smallest
+//barrier a new use needs: nothing between reads that already see the last write, an execution dependency for a write
+//after reads, and a memory dependency after a write or for a layout transition. The barriers queue up until
+//ResourceFlush records them together, with vkCmdPipelineBarrier2KHR when VK_KHR_synchronization2 is enabled and
+//vkCmdPipelineBarrier otherwise. A resource gets at most one barrier between two flushes.
+#define RESOURCE_WRITE_ACCESS (VK_ACCESS_2_SHADER_WRITE_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT_KHR | VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR | VK_ACCESS_2_HOST_WRITE_BIT_KHR | VK_ACCESS_2_MEMORY_WRITE_BIT_KHR)
+
+//How a pass uses a resource, only stage and access bits that also exist in the classic flags
+struct ResourceUsage {
+	VkPipelineStageFlags2KHR stages;
+	VkAccessFlags2KHR access;
+	VkImageLayout layout; //ignored for buffers
+};
+
+struct ResourceState {
+	VkImageLayout layout;
+	VkPipelineStageFlags2KHR writeStages; //of the last write or layout transition
+	VkAccessFlags2KHR writeAccess; //to make available, 0 after a transition
+	VkPipelineStageFlags2KHR readStages; //since the last write
+	VkPipelineStageFlags2KHR visibleStages; //the last write is visible to these stages and accesses
+	VkAccessFlags2KHR visibleAccess;
+};
+
+struct TrackedImage {
+	VkImage image;
+	VkImageSubresourceRange range;
+	ResourceState state;
+};
+
+struct TrackedBuffer {
+	VkBuffer buffer;
+	ResourceState state;
+};
+
+struct ResourceTracker {
+	bool synchronization2;
+	std::vector<VkImageMemoryBarrier2KHR> imageBarriers;
+	std::vector<VkBufferMemoryBarrier2KHR> bufferBarriers;
+	std::vector<VkImageMemoryBarrier> classicImageBarriers; //scratch of the fallback
+	std::vector<VkBufferMemoryBarrier> classicBufferBarriers;
+
+	//Since the last ResourceTrackerSummary
+	uint64_t barriers;
+	uint64_t batches;
+	uint64_t elided; //uses that needed no barrier
+};
+
+ResourceTracker CreateResourceTracker(bool synchronization2)
+{
+	ResourceTracker tracker{};
+	tracker.synchronization2 = synchronization2;
+	return tracker;
+}
+
+//Moves state to usage, returns false when the use needs no barrier, or its source scope and old layout otherwise
+bool ResourceTransition(ResourceState& state, const ResourceUsage& usage, VkPipelineStageFlags2KHR* srcStages, VkAccessFlags2KHR* srcAccess)
+{
+	bool write = (usage.access & RESOURCE_WRITE_ACCESS) != 0;
+	bool transition = usage.layout != state.layout;
+
+	//Reads of the same layout only wait when the last write is not visible to them yet
+	if(!write && !transition) {
+		state.readStages |= usage.stages;
+		if(!state.writeStages || (!(usage.stages & ~state.visibleStages) && !(usage.access & ~state.visibleAccess)))
+			return false;
+		*srcStages = state.writeStages;
+		*srcAccess = state.writeAccess;
+		state.visibleStages |= usage.stages;
+		state.visibleAccess |= usage.access;
+		return true;
+	}
+
+	//Writes wait for the reads since the last write, and for that write itself
+	*srcStages = state.writeStages | state.readStages;
+	*srcAccess = state.writeAccess;
+	bool needed = transition || *srcStages;
+	if(write)
+		state = {usage.layout, usage.stages, usage.access & RESOURCE_WRITE_ACCESS, 0, 0, 0};
+	else
+		state = {usage.layout, usage.stages, 0, usage.stages, usage.stages, usage.access};
+	return needed;
+}
+
+//discard does not keep the contents across a layout transition, returns true when a barrier was queued
+//A use that needs no barrier may follow a pending one, like the acquire half of an ownership transfer
+bool TrackImage(ResourceTracker& tracker, TrackedImage& image, const ResourceUsage& usage, bool discard = false)
+{
+	VkImageLayout oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : image.state.layout;
+	VkPipelineStageFlags2KHR srcStages;
+	VkAccessFlags2KHR srcAccess;
+	if(!ResourceTransition(image.state, usage, &srcStages, &srcAccess)) {
+		++tracker.elided;
+		return false;
+	}
+	ASSERT(std::none_of(tracker.imageBarriers.cbegin(), tracker.imageBarriers.cend(), [&](auto& barrier) { return barrier.image == image.image; }) && "The image already has a pending barrier");
+	tracker.imageBarriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr, srcStages, srcAccess, usage.stages, usage.access, oldLayout, usage.layout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, image.image, image.range});
+	return true;
+}
+
+//The use was synchronized outside of the tracker, only moves the state
+void TrackImageAssume(TrackedImage& image, const ResourceUsage& usage)
+{
+	VkPipelineStageFlags2KHR srcStages;
+	VkAccessFlags2KHR srcAccess;
+	ResourceTransition(image.state, usage, &srcStages, &srcAccess);
+}
+
+bool TrackBuffer(ResourceTracker& tracker, TrackedBuffer& buffer, const ResourceUsage& usage)
+{
+	ResourceUsage bufferUsage = {usage.stages, usage.access, VK_IMAGE_LAYOUT_UNDEFINED};
+	VkPipelineStageFlags2KHR srcStages;
+	VkAccessFlags2KHR srcAccess;
+	if(!ResourceTransition(buffer.state, bufferUsage, &srcStages, &srcAccess)) {
+		++tracker.elided;
+		return false;
+	}
+	ASSERT(std::none_of(tracker.bufferBarriers.cbegin(), tracker.bufferBarriers.cend(), [&](auto& barrier) { return barrier.buffer == buffer.buffer; }) && "The buffer already has a pending barrier");
+	tracker.bufferBarriers.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2_KHR, nullptr, srcStages, srcAccess, usage.stages, usage.access, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, buffer.buffer, 0, VK_WHOLE_SIZE});
+	return true;
+}
+
+//Acquire half of a queue family ownership transfer, oldLayout and the families match the release on the other queue
+//The semaphore the submission waits on is waited at usage.stages, which the barrier chains from
+void TrackImageAcquire(ResourceTracker& tracker, TrackedImage& image, const ResourceUsage& usage, VkImageLayout oldLayout, uint32_t srcQueueFamilyIndex, uint32_t dstQueueFamilyIndex)
+{
+	tracker.imageBarriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2_KHR, nullptr, usage.stages, 0, usage.stages, usage.access, oldLayout, usage.layout, srcQueueFamilyIndex, dstQueueFamilyIndex, image.image, image.range});
+	image.state = {usage.layout, usage.stages, 0, usage.stages, usage.stages, usage.access};
+}
+
+//Records every queued barrier in one call
+void ResourceFlush(const VulkanDeviceDispatch& vkd, ResourceTracker& tracker, VkCommandBuffer commandBuffer)
+{
+	if(tracker.imageBarriers.empty() && tracker.bufferBarriers.empty())
+		return;
+	tracker.barriers += tracker.imageBarriers.size() + tracker.bufferBarriers.size();
+	++tracker.batches;
+
+	if(tracker.synchronization2) {
+		VkDependencyInfoKHR dependencyInfo{VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR};
+		dependencyInfo.bufferMemoryBarrierCount = static_cast<uint32_t>(tracker.bufferBarriers.size());
+		dependencyInfo.pBufferMemoryBarriers = tracker.bufferBarriers.data();
+		dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(tracker.imageBarriers.size());
+		dependencyInfo.pImageMemoryBarriers = tracker.imageBarriers.data();
+		vkd.vkCmdPipelineBarrier2KHR(commandBuffer, &dependencyInfo);
+	}
+	else {
+		//Classic barriers share one pair of stage masks, the classic stage and access bits have the same values
+		VkPipelineStageFlags srcStages = 0, dstStages = 0;
+		tracker.classicImageBarriers.clear();
+		tracker.classicBufferBarriers.clear();
+		for(auto& b : tracker.imageBarriers) {
+			srcStages |= static_cast<VkPipelineStageFlags>(b.srcStageMask);
+			dstStages |= static_cast<VkPipelineStageFlags>(b.dstStageMask);
+			tracker.classicImageBarriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, static_cast<VkAccessFlags>(b.srcAccessMask), static_cast<VkAccessFlags>(b.dstAccessMask), b.oldLayout, b.newLayout, b.srcQueueFamilyIndex, b.dstQueueFamilyIndex, b.image, b.subresourceRange});
+		}
+		for(auto& b : tracker.bufferBarriers) {
+			srcStages |= static_cast<VkPipelineStageFlags>(b.srcStageMask);
+			dstStages |= static_cast<VkPipelineStageFlags>(b.dstStageMask);
+			tracker.classicBufferBarriers.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, static_cast<VkAccessFlags>(b.srcAccessMask), static_cast<VkAccessFlags>(b.dstAccessMask), b.srcQueueFamilyIndex, b.dstQueueFamilyIndex, b.buffer, b.offset, b.size});
+		}
+		//VK_PIPELINE_STAGE_2_NONE_KHR has no classic equivalent
+		vkd.vkCmdPipelineBarrier(commandBuffer, srcStages ? srcStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT), dstStages ? dstStages : static_cast<VkPipelineStageFlags>(VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT), 0, 0, nullptr,
+		                         static_cast<uint32_t>(tracker.classicBufferBarriers.size()), tracker.classicBufferBarriers.data(), static_cast<uint32_t>(tracker.classicImageBarriers.size()), tracker.classicImageBarriers.data());
+	}
+	tracker.imageBarriers.clear();
+	tracker.bufferBarriers.clear();
+}
+
+//"Barriers (synchronization2): 180 in 120 batches, 60 elided", then restarts the counts
+int ResourceTrackerSummary(ResourceTracker& tracker, TCHAR* buffer, size_t size)
+{
+	int length = _stprintf_s(buffer, size, TEXT("Barriers (%s): %llu in %llu batches, %llu elided"), tracker.synchronization2 ? TEXT("synchronization2") : TEXT("classic"), static_cast<unsigned long long>(tracker.barriers),
+	                         static_cast<unsigned long long>(tracker.batches), static_cast<unsigned long long>(tracker.elided));
+	tracker.barriers = tracker.batches = tracker.elided = 0;
+	return length;
+}
+
+//Render graph
+//Passes declare the images they use and how, and run in the order they are declared. Compiling walks them backwards
+//from the imported images that leave the frame: a pass is culled when nothing downstream reads what it writes.
+//Transient images live from the first to the last pass that uses them, the graph creates them swap chain sized and
+//places those whose lifetimes do not overlap in the same memory. Every execution tracks the barriers of each pass
+//and flushes them in one batch, the first use of an aliased image also waits for the image it replaces.
+//Compiled once, then executed every frame without allocating.
+#define RENDER_GRAPH_NONE UINT32_MAX
+
+struct RenderGraphAccess {
+	uint32_t image;
+	ResourceUsage usage;
+	bool discard = false; //overwrites the whole image without reading it
+	bool renderPass = false; //the pass's render pass does the transition, usage has the layout it leaves the image in
+};
+
+struct RenderGraphPass {
+	LPCTSTR name;
+	std::vector<RenderGraphAccess> accesses;
+	std::function<void(VkCommandBuffer)> execute;
+	bool culled;
+};
+
+struct RenderGraphImage {
+	LPCTSTR name;
+	bool imported;
+	ResourceUsage finalUsage; //imported only, layout VK_IMAGE_LAYOUT_UNDEFINED when the image is not an output
+	TrackedImage* tracked; //bound by RenderGraphImport, or &transient
+	TrackedImage transient;
+	VkFormat format;
+	VkImageUsageFlags usage;
+	VkImageView view; //transient only
+	uint32_t firstPass, lastPass; //RENDER_GRAPH_NONE when no pass uses it
+	uint32_t aliased; //image whose memory this one takes over at firstPass, itself when it is alone in its memory
+};
+
+//Retired by a resize, destroyed once the last frame that used them is complete
+struct RenderGraphRetired {
+	VkImage image;
+	VkImageView view;
+	DeviceAllocation memory;
+	uint64_t timelineValue;
+};
+
+struct RenderGraph {
+	std::vector<RenderGraphImage> images;
+	std::vector<RenderGraphPass> passes;
+	std::vector<DeviceAllocation> memories; //one per group of aliased images
+	std::vector<RenderGraphRetired> retired;
+	VkExtent2D extent;
+	uint32_t culledPasses;
+	VkDeviceSize transientBytes; //requirements of the transient images
+	VkDeviceSize aliasedBytes; //memory they take once aliased
+};
+
+//finalUsage is applied after the last pass, an image without it only feeds the passes
+uint32_t RenderGraphImportImage(RenderGraph& graph, LPCTSTR name, const ResourceUsage& finalUsage)
+{
+	RenderGraphImage image{name, true, finalUsage};
+	graph.images.push_back(image);
+	return static_cast<uint32_t>(graph.images.size() - 1);
+}
+
+//Swap chain sized, single mip and layer
+uint32_t RenderGraphCreateImage(RenderGraph& graph, LPCTSTR name, VkFormat format, VkImageUsageFlags usage)
+{
+	RenderGraphImage image{name, false};
+	image.format = format;
+	image.usage = usage;
+	graph.images.push_back(image);
+	return static_cast<uint32_t>(graph.images.size() - 1);
+}
+
+void RenderGraphAddPass(RenderGraph& graph, LPCTSTR name, std::initializer_list<RenderGraphAccess> accesses, std::function<void(VkCommandBuffer)> execute)
+{
+	graph.passes.push_back({name, accesses, std::move(execute), false});
+}
+
+//Culls the passes whose writes are never read and computes the lifetimes of the transient images
+void RenderGraphCompile(RenderGraph& graph)
+{
+	std::vector<bool> needed(graph.images.size());
+	for(size_t i = 0; i < graph.images.size(); ++i)
+		needed[i] = graph.images[i].imported && graph.images[i].finalUsage.layout != VK_IMAGE_LAYOUT_UNDEFINED;
+
+	graph.culledPasses = 0;
+	for(size_t p = graph.passes.size(); p-- > 0;) {
+		auto& pass = graph.passes[p];
+		//Passes that write nothing are kept for their side effects
+		bool writes = false, live = false;
+		for(auto& access : pass.accesses) {
+			if(access.usage.access & RESOURCE_WRITE_ACCESS) {
+				writes = true;
+				live = live || needed[access.image];
+			}
+		}
+		pass.culled = writes && !live;
+		if(pass.culled) {
+			++graph.culledPasses;
+			continue;
+		}
+		for(auto& access : pass.accesses) {
+			if(access.discard)
+				needed[access.image] = false;
+		}
+		for(auto& access : pass.accesses) {
+			if(!access.discard)
+				needed[access.image] = true;
+		}
+	}
+
+	for(auto& image : graph.images)
+		image.firstPass = image.lastPass = RENDER_GRAPH_NONE;
+	for(uint32_t p = 0; p < graph.passes.size(); ++p) {
+		if(graph.passes[p].culled)
+			continue;
+		for(auto& access : graph.passes[p].accesses) {
+			auto& image = graph.images[access.image];
+			ASSERT(std::count_if(graph.passes[p].accesses.cbegin(), graph.passes[p].accesses.cend(), [&](auto& a) { return a.image == access.image; }) == 1 && "A pass uses an image once");
+			ASSERT((image.imported || image.firstPass != RENDER_GRAPH_NONE || access.discard) && "A transient image is written before it is read");
+			if(image.firstPass == RENDER_GRAPH_NONE)
+				image.firstPass = p;
+			image.lastPass = p;
+		}
+	}
+}
+
+//Moves the transient images and their memory to the retired list
+void RenderGraphRetireTransients(RenderGraph& graph, uint64_t timelineValue)
+{
+	for(auto& image : graph.images) {
+		if(!image.imported && image.transient.image) {
+			graph.retired.push_back({image.transient.image, image.view, {}, timelineValue});
+			image.transient.image = VK_NULL_HANDLE;
+			image.view = VK_NULL_HANDLE;
+		}
+	}
+	for(auto& memory : graph.memories)
+		graph.retired.push_back({VK_NULL_HANDLE, VK_NULL_HANDLE, memory, timelineValue});
+	graph.memories.clear();
+	graph.extent = {};
+}
+
+//Destroys what the frames up to completedValue were the last to use
+void RenderGraphCollect(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, RenderGraph& graph, uint64_t completedValue)
+{
+	auto end = std::find_if(graph.retired.begin(), graph.retired.end(), [&](auto& retired) { return retired.timelineValue > completedValue; });
+	for(auto it = graph.retired.begin(); it != end; ++it) {
+		if(it->image) {
+			vkd.vkDestroyImageView(device, it->view, allocator);
+			vkd.vkDestroyImage(device, it->image, allocator);
+		}
+		else {
+			DeviceFree(vkd, device, deviceAllocator, it->memory);
+		}
+	}
+	graph.retired.erase(graph.retired.begin(), end);
+}
+
+//Recreates the transient images at extent, the current ones are destroyed once timelineValue is reached
+//Images are placed largest first in the first memory whose images are all dead by the time they are used
+void RenderGraphResize(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, RenderGraph& graph, VkExtent2D extent, uint64_t timelineValue)
+{
+	RenderGraphRetireTransients(graph, timelineValue);
+	graph.extent = extent;
+	graph.transientBytes = graph.aliasedBytes = 0;
+
+	struct Placement {
+		uint32_t image;
+		VkMemoryRequirements requirements;
+		uint32_t memory;
+	};
+	std::vector<Placement> placements;
+	for(uint32_t i = 0; i < graph.images.size(); ++i) {
+		auto& image = graph.images[i];
+		if(image.imported || image.firstPass == RENDER_GRAPH_NONE)
+			continue;
+		VkImageCreateInfo ici{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+		ici.imageType = VK_IMAGE_TYPE_2D;
+		ici.format = image.format;
+		ici.extent = {extent.width, extent.height, 1};
+		ici.mipLevels = 1;
+		ici.arrayLayers = 1;
+		ici.samples = VK_SAMPLE_COUNT_1_BIT;
+		ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+		ici.usage = image.usage;
+		ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image.transient = {VK_NULL_HANDLE, {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+		VK_ASSERT(vkd.vkCreateImage(device, &ici, allocator, &image.transient.image));
+		image.tracked = &image.transient;
+
+		Placement placement = {i, {}, RENDER_GRAPH_NONE};
+		vkd.vkGetImageMemoryRequirements(device, image.transient.image, &placement.requirements);
+		graph.transientBytes += placement.requirements.size;
+		placements.push_back(placement);
+	}
+	std::sort(placements.begin(), placements.end(), [](auto& a, auto& b) { return a.requirements.size > b.requirements.size; });
+
+	//Requirements of each memory, met by every image placed in it
+	std::vector<VkMemoryRequirements> memories;
+	for(auto& placement : placements) {
+		auto& image = graph.images[placement.image];
+		for(uint32_t m = 0; m < memories.size() && placement.memory == RENDER_GRAPH_NONE; ++m) {
+			if(!(memories[m].memoryTypeBits & placement.requirements.memoryTypeBits))
+				continue;
+			bool overlaps = std::any_of(placements.cbegin(), placements.cend(), [&](auto& other) {
+				auto& otherImage = graph.images[other.image];
+				return other.memory == m && otherImage.firstPass <= image.lastPass && image.firstPass <= otherImage.lastPass;
+			});
+			if(!overlaps) {
+				placement.memory = m;
+				memories[m].size = std::max(memories[m].size, placement.requirements.size);
+				memories[m].alignment = std::max(memories[m].alignment, placement.requirements.alignment);
+				memories[m].memoryTypeBits &= placement.requirements.memoryTypeBits;
+			}
+		}
+		if(placement.memory == RENDER_GRAPH_NONE) {
+			placement.memory = static_cast<uint32_t>(memories.size());
+			memories.push_back(placement.requirements);
+		}
+	}
+
+	for(auto& requirements : memories) {
+		graph.memories.push_back(DeviceAllocate(vkd, device, deviceAllocator, requirements, MemoryUsage::GpuOnly, true));
+		graph.aliasedBytes += requirements.size;
+	}
+
+	//Each image of a memory takes it over from the one used before it, the first from the last one of the previous frame
+	for(auto& placement : placements) {
+		auto& image = graph.images[placement.image];
+		auto& memory = graph.memories[placement.memory];
+		VK_ASSERT(vkd.vkBindImageMemory(device, image.transient.image, memory.memory, memory.offset));
+
+		VkImageViewCreateInfo ivci{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+		ivci.image = image.transient.image;
+		ivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		ivci.format = image.format;
+		ivci.subresourceRange = image.transient.range;
+		VK_ASSERT(vkd.vkCreateImageView(device, &ivci, allocator, &image.view));
+
+		uint32_t latestBefore = RENDER_GRAPH_NONE, latest = RENDER_GRAPH_NONE;
+		for(auto& other : placements) {
+			if(other.memory != placement.memory || other.image == placement.image)
+				continue;
+			uint32_t firstPass = graph.images[other.image].firstPass;
+			if(firstPass < image.firstPass && (latestBefore == RENDER_GRAPH_NONE || firstPass > graph.images[latestBefore].firstPass))
+				latestBefore = other.image;
+			if(latest == RENDER_GRAPH_NONE || firstPass > graph.images[latest].firstPass)
+				latest = other.image;
+		}
+		image.aliased = latestBefore != RENDER_GRAPH_NONE ? latestBefore : latest != RENDER_GRAPH_NONE ? latest : placement.image;
+	}
+}
+
+//Binds an imported image for the next execution
+void RenderGraphImport(RenderGraph& graph, uint32_t image, TrackedImage& tracked)
+{
+	ASSERT(graph.images[image].imported);
+	graph.images[image].tracked = &tracked;
+}
+
+VkImage RenderGraphGetImage(const RenderGraph& graph, uint32_t image)
+{
+	return graph.images[image].tracked->image;
+}
+
+VkImageView RenderGraphGetView(const RenderGraph& graph, uint32_t image)
+{
+	ASSERT(!graph.images[image].imported);
+	return graph.images[image].view;
+}
+
+//Records the passes that were not culled, each in a profiler zone with its barriers
+void RenderGraphExecute(const VulkanDeviceDispatch& vkd, RenderGraph& graph, ResourceTracker& tracker, GpuProfiler& profiler, VkCommandBuffer commandBuffer)
+{
+	for(uint32_t p = 0; p < graph.passes.size(); ++p) {
+		auto& pass = graph.passes[p];
+		if(pass.culled)
+			continue;
+		auto zone = GpuZoneBegin(vkd, profiler, commandBuffer, pass.name);
+		for(auto& access : pass.accesses) {
+			auto& image = graph.images[access.image];
+			ASSERT(image.tracked && "Imported images are bound before every execution");
+			//The memory was last used by the image this one replaces, its contents are discarded
+			if(!image.imported && image.firstPass == p && image.aliased != access.image) {
+				auto& previous = graph.images[image.aliased].transient.state;
+				image.transient.state = {VK_IMAGE_LAYOUT_UNDEFINED, previous.writeStages | previous.readStages, previous.writeAccess, 0, 0, 0};
+			}
+			if(access.renderPass)
+				TrackImageAssume(*image.tracked, access.usage);
+			else
+				TrackImage(tracker, *image.tracked, access.usage, access.discard);
+		}
+		ResourceFlush(vkd, tracker, commandBuffer);
+		pass.execute(commandBuffer);
+		GpuZoneEnd(vkd, profiler, commandBuffer, zone);
+	}
+
+	for(auto& image : graph.images) {
+		if(image.imported && image.finalUsage.layout != VK_IMAGE_LAYOUT_UNDEFINED)
+			TrackImage(tracker, *image.tracked, image.finalUsage);
+	}
+	ResourceFlush(vkd, tracker, commandBuffer);
+}
+
+//"Render graph: 3 passes, 1 culled, 1 transient images, 8.0 MB in 8.0 MB of memory"
+int RenderGraphSummary(const RenderGraph& graph, TCHAR* buffer, size_t size)
+{
+	uint32_t transientImages = static_cast<uint32_t>(std::count_if(graph.images.cbegin(), graph.images.cend(), [](auto& image) { return !image.imported && image.firstPass != RENDER_GRAPH_NONE; }));
+	return _stprintf_s(buffer, size, TEXT("Render graph: %u passes, %u culled, %u transient images, %.1f MB in %.1f MB of memory"), static_cast<uint32_t>(graph.passes.size()) - graph.culledPasses, graph.culledPasses, transientImages,
+	                   graph.transientBytes / 1048576.0, graph.aliasedBytes / 1048576.0);
+}
+
+void DestroyRenderGraph(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, RenderGraph& graph)
+{
+	RenderGraphRetireTransients(graph, 0);
+	RenderGraphCollect(vkd, device, deviceAllocator, graph, UINT64_MAX);
+}
+
+//Upload ring
+//One persistently mapped buffer in host visible memory, written and reclaimed in order. The CPU writes upload data
+//straight into the mapping, and the copies queued between two frames are recorded as one batch at the start of the
+//next frame's command buffer. The range each frame wrote is tagged with its timeline value and returns to the ring
+//once the timeline reaches it, so uploads never allocate and only wait when the ring is full.
+//With a dedicated transfer queue the batch is recorded and submitted on that queue instead, so large copies overlap
+//rendering. Its copies release the destinations to the graphics family, and the frame waits on the transfer timeline
+//and acquires them back before the first read.
+#define UPLOAD_RING_SIZE (8 * 1024 * 1024)
+#define UPLOAD_COMMAND_BUFFERS 4 //transfer submissions in flight
+
+struct UploadBufferCopy {
+	VkBuffer buffer;
+	VkBufferCopy region;
+	VkPipelineStageFlags stage; //where the destination is read
+	VkAccessFlags access;
+	uint64_t readUntil; //graphics timeline value of the last submission reading the old contents, 0 for none
+};
+
+struct UploadImageCopy {
+	VkImage image;
+	VkBufferImageCopy region;
+	VkImageLayout layout; //after the copy
+	VkPipelineStageFlags stage;
+	VkAccessFlags access;
+	uint64_t readUntil;
+};
+
+//End of the bytes a submission read, free once the timeline reaches value
+struct UploadFence {
+	uint64_t end;
+	uint64_t value;
+};
+
+struct UploadRing {
+	VkBuffer buffer;
+	DeviceAllocation memory;
+	VkDeviceSize alignment;
+	uint64_t head; //positions grow forever, modulo UPLOAD_RING_SIZE in the buffer
+	uint64_t tail;
+	uint64_t recorded; //end of the bytes recorded in a command buffer that is not submitted yet
+	std::vector<UploadFence> fences;
+	std::vector<UploadBufferCopy> bufferCopies;
+	std::vector<UploadImageCopy> imageCopies;
+	QueueTimeline* timeline; //of the queue that executes the copies
+	QueueTimeline* graphicsTimeline;
+
+	//Transfer queue of another family, only when async
+	bool async;
+	uint32_t transferQueueFamilyIndex;
+	uint32_t graphicsQueueFamilyIndex;
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffers[UPLOAD_COMMAND_BUFFERS];
+	uint64_t commandBufferValues[UPLOAD_COMMAND_BUFFERS];
+	uint32_t nextCommandBuffer;
+	std::vector<VkBufferMemoryBarrier> acquireBuffers; //released by the transfer queue, acquired by the next frame
+	std::vector<VkImageMemoryBarrier> acquireImages;
+	VkPipelineStageFlags acquireStages;
+	uint64_t transferValue; //transfer timeline value the next graphics submission waits on, 0 for none
+
+	//Since the last UploadRingSummary
+	uint64_t bytes;
+	uint64_t frames;
+	uint64_t maxFrameBytes;
+	uint64_t frameBytes; //queued for the next batch
+	uint64_t stalls; //since start
+	int64_t summaryStart;
+};
+
+//Uploads run on transferTimeline when its queue is of another family than the graphics queue, in the frame otherwise
+UploadRing CreateUploadRing(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, VkDeviceSize optimalBufferCopyOffsetAlignment, QueueTimeline& graphicsTimeline, uint32_t graphicsQueueFamilyIndex, QueueTimeline& transferTimeline, uint32_t transferQueueFamilyIndex)
+{
+	UploadRing ring{};
+	CreateBuffer(vkd, device, deviceAllocator, UPLOAD_RING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, MemoryUsage::Upload, &ring.buffer, &ring.memory);
+	//Texel blocks of every format divide 16, copies also need a multiple of 4
+	ring.alignment = std::max<VkDeviceSize>(16, optimalBufferCopyOffsetAlignment);
+	ring.async = transferQueueFamilyIndex != graphicsQueueFamilyIndex;
+	ring.timeline = ring.async ? &transferTimeline : &graphicsTimeline;
+	ring.graphicsTimeline = &graphicsTimeline;
+	ring.transferQueueFamilyIndex = transferQueueFamilyIndex;
+	ring.graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+	if(ring.async) {
+		VkCommandPoolCreateInfo cpci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+		cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		cpci.queueFamilyIndex = transferQueueFamilyIndex;
+		VK_ASSERT(vkd.vkCreateCommandPool(device, &cpci, allocator, &ring.commandPool));
+		VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+		ai.commandPool = ring.commandPool;
+		ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		ai.commandBufferCount = UPLOAD_COMMAND_BUFFERS;
+		VK_ASSERT(vkd.vkAllocateCommandBuffers(device, &ai, ring.commandBuffers));
+	}
+	ring.summaryStart = GetTickNanoseconds();
+	return ring;
+}
+
+void DestroyUploadRing(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, UploadRing& ring)
+{
+	if(ring.commandPool)
+		vkd.vkDestroyCommandPool(device, ring.commandPool, allocator);
+	DestroyBuffer(vkd, device, deviceAllocator, ring.buffer, ring.memory);
+}
+
+//Returns the mapped space for size bytes and its offset in ring.buffer, waits for the GPU only when the ring is full
+uint8_t* UploadReserve(const VulkanDeviceDispatch& vkd, VkDevice device, UploadRing& ring, VkDeviceSize size, VkDeviceSize* offset)
+{
+	if(size > UPLOAD_RING_SIZE)
+		Abort(TEXT("The upload is larger than the upload ring"));
+
+	//Space never wraps within an upload, the end of the buffer is skipped instead
+	uint64_t begin = (ring.head + ring.alignment - 1) / ring.alignment * ring.alignment;
+	if(begin % UPLOAD_RING_SIZE + size > UPLOAD_RING_SIZE)
+		begin += UPLOAD_RING_SIZE - begin % UPLOAD_RING_SIZE;
+	uint64_t end = begin + size;
+
+	//Reclaim what completed submissions read, then stall on the oldest ones until there is room
+	size_t completed = 0;
+	while(completed < ring.fences.size() && TimelineReached(vkd, device, *ring.timeline, ring.fences[completed].value))
+		ring.tail = ring.fences[completed++].end;
+	bool stalled = false;
+	while(end - ring.tail > UPLOAD_RING_SIZE && completed < ring.fences.size()) {
+		TimelineWaitValue(vkd, device, *ring.timeline, ring.fences[completed].value);
+		ring.tail = ring.fences[completed++].end;
+		stalled = true;
+	}
+	ring.fences.erase(ring.fences.begin(), ring.fences.begin() + completed);
+	ring.stalls += stalled;
+	//Bytes of the batch being recorded are not covered by a fence yet
+	if(end - ring.tail > UPLOAD_RING_SIZE)
+		Abort(TEXT("The uploads of a single frame do not fit the upload ring"));
+
+	ring.head = end;
+	ring.frameBytes += size;
+	*offset = begin % UPLOAD_RING_SIZE;
+	return ring.memory.mapped + *offset;
+}
+
+//readUntil only matters to async uploads, the frame's own barrier orders the copy after earlier reads otherwise
+void UploadBuffer(const VulkanDeviceDispatch& vkd, VkDevice device, UploadRing& ring, VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size, VkPipelineStageFlags stage, VkAccessFlags access, uint64_t readUntil)
+{
+	VkDeviceSize ringOffset;
+	memcpy(UploadReserve(vkd, device, ring, size, &ringOffset), data, static_cast<size_t>(size));
+	ring.bufferCopies.push_back({buffer, {ringOffset, offset, size}, stage, access, readUntil});
+}
+
+//Replaces the whole first mip level and layer, tightly packed data
+void UploadImage(const VulkanDeviceDispatch& vkd, VkDevice device, UploadRing& ring, VkImage image, VkExtent3D extent, const void* data, VkDeviceSize size, VkImageLayout layout, VkPipelineStageFlags stage, VkAccessFlags access, uint64_t readUntil)
+{
+	VkDeviceSize ringOffset;
+	memcpy(UploadReserve(vkd, device, ring, size, &ringOffset), data, static_cast<size_t>(size));
+	VkBufferImageCopy region{};
+	region.bufferOffset = ringOffset;
+	region.imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+	region.imageExtent = extent;
+	ring.imageCopies.push_back({image, region, layout, stage, access, readUntil});
+}
+
+//One vkCmdCopyBuffer per destination buffer, with every region queued for it
+void UploadRecordCopies(const VulkanDeviceDispatch& vkd, UploadRing& ring, VkCommandBuffer commandBuffer)
+{
+	std::sort(ring.bufferCopies.begin(), ring.bufferCopies.end(), [](const UploadBufferCopy& a, const UploadBufferCopy& b) { return a.buffer < b.buffer; });
+	std::vector<VkBufferCopy> regions;
+	for(size_t i = 0; i < ring.bufferCopies.size();) {
+		regions.clear();
+		size_t first = i;
+		for(; i < ring.bufferCopies.size() && ring.bufferCopies[i].buffer == ring.bufferCopies[first].buffer; ++i)
+			regions.push_back(ring.bufferCopies[i].region);
+		vkd.vkCmdCopyBuffer(commandBuffer, ring.buffer, ring.bufferCopies[first].buffer, static_cast<uint32_t>(regions.size()), regions.data());
+	}
+	for(auto& copy : ring.imageCopies)
+		vkd.vkCmdCopyBufferToImage(commandBuffer, ring.buffer, copy.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy.region);
+}
+
+//Records and submits the queued copies on the transfer queue, and queues the matching acquire barriers
+//The destinations are not released back by the graphics queue: the copies replace their contents, and the
+//submission waits on the graphics timeline until the previous readers are done with them.
+void UploadSubmitTransfer(const VulkanDeviceDispatch& vkd, VkDevice device, UploadRing& ring)
+{
+	uint32_t index = ring.nextCommandBuffer;
+	ring.nextCommandBuffer = (index + 1) % UPLOAD_COMMAND_BUFFERS;
+	VkCommandBuffer commandBuffer = ring.commandBuffers[index];
+	TimelineWaitValue(vkd, device, *ring.timeline, ring.commandBufferValues[index]);
+	VK_ASSERT(vkd.vkResetCommandBuffer(commandBuffer, 0));
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+	VK_ASSERT(vkd.vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+
+	VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	uint64_t readUntil = 0;
+	std::vector<VkImageMemoryBarrier> barriers;
+	for(auto& copy : ring.bufferCopies)
+		readUntil = std::max(readUntil, copy.readUntil);
+	for(auto& copy : ring.imageCopies) {
+		readUntil = std::max(readUntil, copy.readUntil);
+		barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, copy.image, range});
+	}
+	if(!barriers.empty())
+		vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	UploadRecordCopies(vkd, ring, commandBuffer);
+
+	//Release, the same barriers are recorded again on the graphics queue to acquire
+	barriers.clear();
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	for(auto& copy : ring.bufferCopies) {
+		bufferBarriers.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, 0, ring.transferQueueFamilyIndex, ring.graphicsQueueFamilyIndex, copy.buffer, copy.region.dstOffset, copy.region.size});
+		ring.acquireBuffers.push_back({VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER, nullptr, 0, copy.access, ring.transferQueueFamilyIndex, ring.graphicsQueueFamilyIndex, copy.buffer, copy.region.dstOffset, copy.region.size});
+		ring.acquireStages |= copy.stage;
+	}
+	for(auto& copy : ring.imageCopies) {
+		barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.layout, ring.transferQueueFamilyIndex, ring.graphicsQueueFamilyIndex, copy.image, range});
+		ring.acquireImages.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, 0, copy.access, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.layout, ring.transferQueueFamilyIndex, ring.graphicsQueueFamilyIndex, copy.image, range});
+		ring.acquireStages |= copy.stage;
+	}
+	vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(), static_cast<uint32_t>(barriers.size()), barriers.data());
+	VK_ASSERT(vkd.vkEndCommandBuffer(commandBuffer));
+
+	TimelineWait graphicsDone = {ring.graphicsTimeline->semaphore, readUntil, VK_PIPELINE_STAGE_TRANSFER_BIT};
+	ring.transferValue = TimelineSubmit(vkd, *ring.timeline, commandBuffer, readUntil ? 1 : 0, &graphicsDone, VK_NULL_HANDLE);
+	ring.commandBufferValues[index] = ring.transferValue;
+	ring.fences.push_back({ring.head, ring.transferValue});
+}
+
+//Records the queued copies, with one barrier before and one after the whole batch
+//Async rings submit the copies to the transfer queue here and only record the acquire barriers
+void UploadRecord(const VulkanDeviceDispatch& vkd, VkDevice device, UploadRing& ring, VkCommandBuffer commandBuffer)
+{
+	if(ring.bufferCopies.empty() && ring.imageCopies.empty())
+		return;
+
+	if(ring.async) {
+		UploadSubmitTransfer(vkd, device, ring);
+		//Waited for at acquireStages by the semaphore, which the barrier's first scope chains to
+		vkd.vkCmdPipelineBarrier(commandBuffer, ring.acquireStages, ring.acquireStages, 0, 0, nullptr, static_cast<uint32_t>(ring.acquireBuffers.size()), ring.acquireBuffers.data(), static_cast<uint32_t>(ring.acquireImages.size()), ring.acquireImages.data());
+		ring.acquireBuffers.clear();
+		ring.acquireImages.clear();
+		ring.bufferCopies.clear();
+		ring.imageCopies.clear();
+		return;
+	}
+
+	//Previous readers of the destinations finish before they are overwritten, images start over from undefined
+	VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	VkPipelineStageFlags readStages = 0;
+	VkAccessFlags readAccess = 0;
+	std::vector<VkImageMemoryBarrier> barriers;
+	for(auto& copy : ring.bufferCopies) {
+		readStages |= copy.stage;
+		readAccess |= copy.access;
+	}
+	for(auto& copy : ring.imageCopies) {
+		readStages |= copy.stage;
+		readAccess |= copy.access;
+		barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, 0, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, copy.image, range});
+	}
+	vkd.vkCmdPipelineBarrier(commandBuffer, readStages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	UploadRecordCopies(vkd, ring, commandBuffer);
+
+	//Copies are visible to the readers, images move to the layout they are read in
+	barriers.clear();
+	for(auto& copy : ring.imageCopies)
+		barriers.push_back({VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, copy.access, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, copy.layout, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, copy.image, range});
+	VkMemoryBarrier memoryBarrier = {VK_STRUCTURE_TYPE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, readAccess};
+	vkd.vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, readStages, 0, 1, &memoryBarrier, 0, nullptr, static_cast<uint32_t>(barriers.size()), barriers.data());
+
+	ring.bufferCopies.clear();
+	ring.imageCopies.clear();
+	ring.recorded = ring.head;
+}
+
+//The transfer submission the next graphics submission waits on, false when there is none
+bool UploadWait(const UploadRing& ring, TimelineWait* wait)
+{
+	if(!ring.transferValue)
+		return false;
+	*wait = {ring.timeline->semaphore, ring.transferValue, ring.acquireStages};
+	return true;
+}
+
+//Call after submitting the command buffer UploadRecord recorded into, value is the submission's timeline value
+void UploadSubmitted(UploadRing& ring, uint64_t value)
+{
+	if(ring.recorded)
+		ring.fences.push_back({ring.recorded, value});
+	ring.recorded = 0;
+	ring.transferValue = 0;
+	ring.acquireStages = 0;
+	ring.bytes += ring.frameBytes;
+	ring.maxFrameBytes = std::max(ring.maxFrameBytes, ring.frameBytes);
+	ring.frameBytes = 0;
+	++ring.frames;
+}
+
+//"Uploads (transfer queue): 0.04 MB/s, 0.7 KB per frame, max 41.0 KB, stalls 0", then restarts the averages
+int UploadRingSummary(UploadRing& ring, TCHAR* buffer, size_t size)
+{
+	auto now = GetTickNanoseconds();
+	double seconds = (now - ring.summaryStart) / 1e9;
+	int length = _stprintf_s(buffer, size, TEXT("Uploads (%s): %.2f MB/s, %.1f KB per frame, max %.1f KB, stalls %llu"), ring.async ? TEXT("transfer queue") : TEXT("in frame"), seconds > 0.0 ? ring.bytes / 1048576.0 / seconds : 0.0,
+	                         ring.frames ? ring.bytes / 1024.0 / ring.frames : 0.0, ring.maxFrameBytes / 1024.0, static_cast<unsigned long long>(ring.stalls));
+	ring.bytes = ring.frames = ring.maxFrameBytes = 0;
+	ring.summaryStart = now;
+	return length;
+}
+
+//Pipeline cache
+//Loaded from disk before any pipeline is created and written back at exit. A file of another device or driver
+//version is dropped up front, by checking its header against the properties of the physical device. Threads that
+//create pipelines get a cache of their own so they never contend on a shared one, those are merged into the main
+//cache before it is written. The file is replaced atomically: the data goes to a temporary file renamed over it.
+
+//Start of the data of a VK_PIPELINE_CACHE_HEADER_VERSION_ONE cache
+struct PipelineCacheHeader {
+	uint32_t headerSize;
+	uint32_t headerVersion;
+	uint32_t vendorID;
+	uint32_t deviceID;
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE];
+};
+
+struct PipelineCache {
+	const char* path; //null to keep the cache in memory only
+	VkPipelineCache cache;
+	std::vector<VkPipelineCache> workerCaches;
+	size_t loadedBytes; //0 on a cold start
+};
+
+//Null when data is a cache of this device and driver, the reason to drop it otherwise
+LPCTSTR PipelineCacheValidate(const std::vector<uint8_t>& data, const VkPhysicalDeviceProperties& properties)
+{
+	PipelineCacheHeader header;
+	if(data.size() < sizeof(header))
+		return TEXT("truncated");
+	memcpy(&header, data.data(), sizeof(header));
+	if(header.headerSize < sizeof(header) || header.headerSize > data.size())
+		return TEXT("invalid header size");
+	if(header.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE)
+		return TEXT("unknown header version");
+	if(header.vendorID != properties.vendorID || header.deviceID != properties.deviceID)
+		return TEXT("written by another device");
+	if(memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+		return TEXT("written by another driver version");
+	return nullptr;
+}
+
+PipelineCache CreatePipelineCache(const VulkanDeviceDispatch& vkd, VkDevice device, const VkPhysicalDeviceProperties& properties, const char* path)
+{
+	PipelineCache cache{path};
+	std::vector<uint8_t> data;
+	if(path) {
+		std::ifstream file(path, std::ios::binary);
+		if(file)
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		LPCTSTR reason = file ? PipelineCacheValidate(data, properties) : nullptr;
+		if(reason) {
+			TCOUT << TEXT("Pipeline cache dropped, ") << reason << std::endl;
+			data.clear();
+		}
+	}
+
+	VkPipelineCacheCreateInfo pcci{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+	pcci.initialDataSize = data.size();
+	pcci.pInitialData = data.data();
+	VK_ASSERT(vkd.vkCreatePipelineCache(device, &pcci, allocator, &cache.cache));
+	cache.loadedBytes = data.size();
+	return cache;
+}
+
+//An empty cache for one thread, merged into the main cache by PipelineCacheSave
+//Create them on the thread that owns cache, before starting the workers
+VkPipelineCache PipelineCacheCreateWorker(const VulkanDeviceDispatch& vkd, VkDevice device, PipelineCache& cache)
+{
+	VkPipelineCacheCreateInfo pcci{VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+	VkPipelineCache workerCache;
+	VK_ASSERT(vkd.vkCreatePipelineCache(device, &pcci, allocator, &workerCache));
+	cache.workerCaches.push_back(workerCache);
+	return workerCache;
+}
+
+//Merges the worker caches, which every worker must be done with, then replaces the file
+void PipelineCacheSave(const VulkanDeviceDispatch& vkd, VkDevice device, PipelineCache& cache)
+{
+	if(!cache.workerCaches.empty()) {
+		VK_ASSERT(vkd.vkMergePipelineCaches(device, cache.cache, static_cast<uint32_t>(cache.workerCaches.size()), cache.workerCaches.data()));
+		for(auto workerCache : cache.workerCaches)
+			vkd.vkDestroyPipelineCache(device, workerCache, allocator);
+		cache.workerCaches.clear();
+	}
+	if(!cache.path)
+		return;
+
+	size_t size;
+	VK_ASSERT(vkd.vkGetPipelineCacheData(device, cache.cache, &size, nullptr));
+	std::vector<uint8_t> data(size);
+	VK_ASSERT(vkd.vkGetPipelineCacheData(device, cache.cache, &size, data.data()));
+
+	std::string temporaryPath = std::string(cache.path) + ".tmp";
+	{
+		std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+		if(!file)
+			Abort(TEXT("Failed to create the pipeline cache file"));
+		file.write(reinterpret_cast<const char*>(data.data()), static_cast<std::streamsize>(size));
+		file.close();
+		if(!file)
+			Abort(TEXT("Failed to write the pipeline cache file"));
+	}
+#ifdef _WIN32
+	bool renamed = MoveFileExA(temporaryPath.c_str(), cache.path, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	bool renamed = rename(temporaryPath.c_str(), cache.path) == 0;
+#endif
+	if(!renamed)
+		Abort(TEXT("Failed to replace the pipeline cache file"));
+}
+
+void DestroyPipelineCache(const VulkanDeviceDispatch& vkd, VkDevice device, PipelineCache& cache)
+{
+	for(auto workerCache : cache.workerCaches)
+		vkd.vkDestroyPipelineCache(device, workerCache, allocator);
+	vkd.vkDestroyPipelineCache(device, cache.cache, allocator);
+}
+
+//Compute fill
+//A compute shader fills a swap chain sized target that the frame copies into the acquired image, instead of clearing it.
+//With a compute-only queue family the dispatch is submitted on that queue for the frame being recorded while the graphics
+//queue still renders the previous one. It releases the target to the graphics family, and the frame waits on the compute
+//timeline and acquires it before the copy. Without one, the dispatch is a pass of the frame's render graph, into a
+//transient image of the graph.
+#define FILL_GROUP_SIZE 8 //LocalSize of shaders/fill.comp.spvasm
+
+struct FillPushConstants {
+	float color[4];
+	uint32_t extent[2];
+};
+
+//One per frame in flight. Async targets own their image and are resized along with the swap chain, in frame ones only
+//bind the image of the render graph
+struct ComputeFillTarget {
+	TrackedImage image;
+	DeviceAllocation memory;
+	VkImageView view; //owned along with image
+	VkExtent2D extent;
+	VkDescriptorSet descriptorSet;
+	VkCommandBuffer commandBuffer; //on the compute family, only when async
+};
+
+struct ComputeFill {
+	bool async;
+	uint32_t computeQueueFamilyIndex;
+	uint32_t graphicsQueueFamilyIndex;
+	QueueTimeline* timeline;
+	VkDescriptorSetLayout setLayout;
+	VkPipelineLayout pipelineLayout;
+	VkPipeline pipeline;
+	VkDescriptorPool descriptorPool;
+	VkCommandPool commandPool;
+	std::vector<ComputeFillTarget> targets;
+	uint64_t computeValue; //compute timeline value the next graphics submission waits on, 0 for none
+};
+
+//The dispatch runs on computeTimeline when its queue is of another family than the graphics queue, in the frame otherwise
+ComputeFill CreateComputeFill(const VulkanDeviceDispatch& vkd, VkDevice device, const ShaderModules& shaderModules, VkPipelineCache pipelineCache, uint32_t frameCount, uint32_t graphicsQueueFamilyIndex, QueueTimeline& computeTimeline, uint32_t computeQueueFamilyIndex)
+{
+	ComputeFill fill{};
+	fill.async = computeQueueFamilyIndex != graphicsQueueFamilyIndex;
+	fill.computeQueueFamilyIndex = computeQueueFamilyIndex;
+	fill.graphicsQueueFamilyIndex = graphicsQueueFamilyIndex;
+	fill.timeline = &computeTimeline;
+	fill.targets.resize(frameCount);
+
+	VkDescriptorSetLayoutBinding binding = {0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr};
+	VkDescriptorSetLayoutCreateInfo dslci{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+	dslci.bindingCount = 1;
+	dslci.pBindings = &binding;
+	VK_ASSERT(vkd.vkCreateDescriptorSetLayout(device, &dslci, allocator, &fill.setLayout));
+
+	VkPushConstantRange pushConstantRange = {VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(FillPushConstants)};
+	VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+	plci.setLayoutCount = 1;
+	plci.pSetLayouts = &fill.setLayout;
+	plci.pushConstantRangeCount = 1;
+	plci.pPushConstantRanges = &pushConstantRange;
+	VK_ASSERT(vkd.vkCreatePipelineLayout(device, &plci, allocator, &fill.pipelineLayout));
+
+	VkComputePipelineCreateInfo cpci{VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+	cpci.stage = {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, nullptr, 0, VK_SHADER_STAGE_COMPUTE_BIT, shaderModules.modules[SHADER("fill.comp")], "main", nullptr};
+	cpci.layout = fill.pipelineLayout;
+	VK_ASSERT(vkd.vkCreateComputePipelines(device, pipelineCache, 1, &cpci, allocator, &fill.pipeline));
+
+	VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, frameCount};
+	VkDescriptorPoolCreateInfo dpci{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+	dpci.maxSets = frameCount;
+	dpci.poolSizeCount = 1;
+	dpci.pPoolSizes = &poolSize;
+	VK_ASSERT(vkd.vkCreateDescriptorPool(device, &dpci, allocator, &fill.descriptorPool));
+	for(auto& target : fill.targets) {
+		VkDescriptorSetAllocateInfo dsai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+		dsai.descriptorPool = fill.descriptorPool;
+		dsai.descriptorSetCount = 1;
+		dsai.pSetLayouts = &fill.setLayout;
+		VK_ASSERT(vkd.vkAllocateDescriptorSets(device, &dsai, &target.descriptorSet));
+	}
+
+	if(fill.async) {
+		VkCommandPoolCreateInfo cpoolci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+		cpoolci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		cpoolci.queueFamilyIndex = computeQueueFamilyIndex;
+		VK_ASSERT(vkd.vkCreateCommandPool(device, &cpoolci, allocator, &fill.commandPool));
+		for(auto& target : fill.targets) {
+			VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+			ai.commandPool = fill.commandPool;
+			ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			ai.commandBufferCount = 1;
+			VK_ASSERT(vkd.vkAllocateCommandBuffers(device, &ai, &target.commandBuffer));
+		}
+	}
+	return fill;
+}
+
+void DestroyComputeFillTarget(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, ComputeFillTarget& target)
+{
+	if(!target.image.image)
+		return;
+	vkd.vkDestroyImageView(device, target.view, allocator);
+	vkd.vkDestroyImage(device, target.image.image, allocator);
+	DeviceFree(vkd, device, deviceAllocator, target.memory);
+	target.image = {};
+}
+
+void DestroyComputeFill(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, ComputeFill& fill)
+{
+	for(auto& target : fill.targets)
+		DestroyComputeFillTarget(vkd, device, deviceAllocator, target);
+	if(fill.commandPool)
+		vkd.vkDestroyCommandPool(device, fill.commandPool, allocator);
+	vkd.vkDestroyDescriptorPool(device, fill.descriptorPool, allocator);
+	vkd.vkDestroyPipeline(device, fill.pipeline, allocator);
+	vkd.vkDestroyPipelineLayout(device, fill.pipelineLayout, allocator);
+	vkd.vkDestroyDescriptorSetLayout(device, fill.setLayout, allocator);
+}
+
+//The previous frame using the target is complete, so its descriptor set is rewritten in place
+void ComputeFillBind(const VulkanDeviceDispatch& vkd, VkDevice device, ComputeFillTarget& target, VkImageView view, VkExtent2D extent)
+{
+	target.view = view;
+	target.extent = extent;
+	VkDescriptorImageInfo imageInfo = {VK_NULL_HANDLE, view, VK_IMAGE_LAYOUT_GENERAL};
+	VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+	write.dstSet = target.descriptorSet;
+	write.dstBinding = 0;
+	write.descriptorCount = 1;
+	write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+	write.pImageInfo = &imageInfo;
+	vkd.vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+}
+
+//Storage support is only guaranteed for R8G8B8A8, the shader writes the channels swapped so the copy lands as B8G8R8A8
+//The previous frame using the target is complete, so it is replaced without waiting
+void ComputeFillResize(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, ComputeFillTarget& target, VkExtent2D extent)
+{
+	DestroyComputeFillTarget(vkd, device, deviceAllocator, target);
+	VkImageCreateInfo ici{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+	ici.imageType = VK_IMAGE_TYPE_2D;
+	ici.format = VK_FORMAT_R8G8B8A8_UNORM;
+	ici.extent = {extent.width, extent.height, 1};
+	ici.mipLevels = 1;
+	ici.arrayLayers = 1;
+	ici.samples = VK_SAMPLE_COUNT_1_BIT;
+	ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+	ici.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+	ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	VK_ASSERT(vkd.vkCreateImage(device, &ici, allocator, &target.image.image));
+	target.image.range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+
+	VkMemoryRequirements memoryRequirements;
+	vkd.vkGetImageMemoryRequirements(device, target.image.image, &memoryRequirements);
+	target.memory = DeviceAllocate(vkd, device, deviceAllocator, memoryRequirements, MemoryUsage::GpuOnly, true);
+	VK_ASSERT(vkd.vkBindImageMemory(device, target.image.image, target.memory.memory, target.memory.offset));
+
+	VkImageViewCreateInfo ivci{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+	ivci.image = target.image.image;
+	ivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+	ivci.format = VK_FORMAT_R8G8B8A8_UNORM;
+	ivci.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+	VkImageView view;
+	VK_ASSERT(vkd.vkCreateImageView(device, &ivci, allocator, &view));
+	ComputeFillBind(vkd, device, target, view, extent);
+}
+
+//The target is in VK_IMAGE_LAYOUT_GENERAL
+void ComputeFillDispatch(const VulkanDeviceDispatch& vkd, ComputeFill& fill, ComputeFillTarget& target, VkCommandBuffer commandBuffer, float red, float green, float blue)
+{
+	FillPushConstants pushConstants = {{blue, green, red, 0.0f}, {target.extent.width, target.extent.height}};
+	vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, fill.pipeline);
+	vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, fill.pipelineLayout, 0, 1, &target.descriptorSet, 0, nullptr);
+	vkd.vkCmdPushConstants(commandBuffer, fill.pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(pushConstants), &pushConstants);
+	vkd.vkCmdDispatch(commandBuffer, (target.extent.width + FILL_GROUP_SIZE - 1) / FILL_GROUP_SIZE, (target.extent.height + FILL_GROUP_SIZE - 1) / FILL_GROUP_SIZE, 1);
+}
+
+//Async only, fills the target of frameIndex on the compute queue with computeBusy bracketing the compute command buffer
+//Call before recording the frame, which acquires the target with the barrier queued in tracker
+TrackedImage& ComputeFillSubmit(const VulkanDeviceDispatch& vkd, VkDevice device, DeviceAllocator& deviceAllocator, ComputeFill& fill, ResourceTracker& tracker, QueueBusy& computeBusy, uint32_t frameIndex, VkExtent2D extent, float red, float green, float blue)
+{
+	ASSERT(fill.async);
+	auto& target = fill.targets[frameIndex];
+	if(target.extent.width != extent.width || target.extent.height != extent.height)
+		ComputeFillResize(vkd, device, deviceAllocator, target, extent);
+
+	VK_ASSERT(vkd.vkResetCommandBuffer(target.commandBuffer, 0));
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+	VK_ASSERT(vkd.vkBeginCommandBuffer(target.commandBuffer, &commandBufferBeginInfo));
+	QueueBusyBegin(vkd, computeBusy, target.commandBuffer, frameIndex);
+	//The previous frame's copy out of the target is complete, its contents are discarded
+	VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, 0, VK_ACCESS_SHADER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_QUEUE_FAMILY_IGNORED, VK_QUEUE_FAMILY_IGNORED, target.image.image, target.image.range};
+	vkd.vkCmdPipelineBarrier(target.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	ComputeFillDispatch(vkd, fill, target, target.commandBuffer, red, green, blue);
+	//Release, the same barrier is recorded again on the graphics queue to acquire
+	VkImageMemoryBarrier release = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, VK_ACCESS_SHADER_WRITE_BIT, 0, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, fill.computeQueueFamilyIndex, fill.graphicsQueueFamilyIndex, target.image.image, target.image.range};
+	vkd.vkCmdPipelineBarrier(target.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &release);
+	QueueBusyEnd(vkd, computeBusy, target.commandBuffer, frameIndex);
+	VK_ASSERT(vkd.vkEndCommandBuffer(target.commandBuffer));
+	fill.computeValue = TimelineSubmit(vkd, *fill.timeline, target.commandBuffer, 0, nullptr, VK_NULL_HANDLE);
+
+	TrackImageAcquire(tracker, target.image, {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL}, VK_IMAGE_LAYOUT_GENERAL, fill.computeQueueFamilyIndex, fill.graphicsQueueFamilyIndex);
+	return target.image;
+}
+
+//In frame only, fills view, an image of the render graph in VK_IMAGE_LAYOUT_GENERAL
+//Bound every frame, the graph recreates its images when the swap chain is resized
+void ComputeFillRecord(const VulkanDeviceDispatch& vkd, VkDevice device, ComputeFill& fill, uint32_t frameIndex, VkCommandBuffer commandBuffer, VkImageView view, VkExtent2D extent, float red, float green, float blue)
+{
+	ASSERT(!fill.async);
+	auto& target = fill.targets[frameIndex];
+	ComputeFillBind(vkd, device, target, view, extent);
+	ComputeFillDispatch(vkd, fill, target, commandBuffer, red, green, blue);
+}
+
+//The compute submission the next graphics submission waits on, false when there is none
+bool ComputeFillWait(ComputeFill& fill, TimelineWait* wait)
+{
+	if(!fill.computeValue)
+		return false;
+	*wait = {fill.timeline->semaphore, fill.computeValue, VK_PIPELINE_STAGE_TRANSFER_BIT};
+	fill.computeValue = 0;
+	return true;
+}
+
+//Timeline trace
+//Zones are appended to a buffer owned by the recording thread, so recording takes no lock and shares no cache line
+//with other threads. Buffers are linked into a list once, when a thread records its first zone, and are read when the
+//trace is exported after the other threads have joined. The GPU zones of each frame go on their own track, moved to the
+//CPU clock through VK_EXT_calibrated_timestamps. The result loads in chrome://tracing and ui.perfetto.dev.
+#define TRACE_BUFFER_EVENTS (1 << 18) //per thread, a full buffer drops new zones
+#define TRACE_TRACK_NAME_SIZE 32
+
+struct TraceEvent {
+	LPCTSTR name;
+	int64_t begin, end; //GetTickNanoseconds
+};
+
+struct TraceBuffer {
+	uint32_t trackId;
+	bool gpu;
+	TCHAR trackName[TRACE_TRACK_NAME_SIZE];
+	std::atomic<uint32_t> count; //written by the owner thread only
+	uint32_t dropped;
+	TraceBuffer* next;
+	TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+struct Trace {
+	bool enabled; //set before any other thread starts
+	int64_t start;
+	std::atomic<TraceBuffer*> buffers;
+	std::atomic<uint32_t> trackCount;
+	TraceBuffer* gpu; //written by the frame loop thread
+
+	//GPU clock calibration, a device tick matched with a host time
+	bool gpuCalibrated;
+	uint64_t gpuTicks;
+	int64_t gpuHostNanoseconds;
+	double timestampPeriod; //nanoseconds per tick
+	uint64_t timestampMask;
+};
+
+static Trace trace;
+
+TraceBuffer* TraceCreateTrack(LPCTSTR name, bool gpu)
+{
+	auto buffer = new TraceBuffer;
+	buffer->trackId = trace.trackCount.fetch_add(1, std::memory_order_relaxed) + 1;
+	buffer->gpu = gpu;
+	_stprintf_s(buffer->trackName, TRACE_TRACK_NAME_SIZE, TEXT("%s"), name);
+	buffer->count.store(0, std::memory_order_relaxed);
+	buffer->dropped = 0;
+
+	//Lock free push, tracks are only ever added
+	buffer->next = trace.buffers.load(std::memory_order_relaxed);
+	while(!trace.buffers.compare_exchange_weak(buffer->next, buffer, std::memory_order_release, std::memory_order_relaxed))
+		;
+	return buffer;
+}
+
+TraceBuffer* TraceThreadBuffer()
+{
+	thread_local TraceBuffer* buffer;
+	if(!buffer)
+		buffer = TraceCreateTrack(TEXT("Thread"), false);
+	return buffer;
+}
+
+void TraceSetThreadName(LPCTSTR name)
+{
+	if(trace.enabled)
+		_stprintf_s(TraceThreadBuffer()->trackName, TRACE_TRACK_NAME_SIZE, TEXT("%s"), name);
+}
+
+void TraceRecord(TraceBuffer* buffer, LPCTSTR name, int64_t begin, int64_t end)
+{
+	uint32_t count = buffer->count.load(std::memory_order_relaxed);
+	if(count == TRACE_BUFFER_EVENTS) {
+		++buffer->dropped;
+		return;
+	}
+	buffer->events[count] = {name, begin, end};
+	buffer->count.store(count + 1, std::memory_order_release);
+}
+
+//Records a zone on the calling thread's track, for regions that are timed already
+void TraceRecord(LPCTSTR name, int64_t begin, int64_t end)
+{
+	if(trace.enabled)
+		TraceRecord(TraceThreadBuffer(), name, begin, end);
+}
+
+//Records the enclosing scope on the calling thread's track
+struct TraceZone {
+	LPCTSTR name;
+	int64_t begin;
+
+	explicit TraceZone(LPCTSTR name) : name(name), begin(trace.enabled ? GetTickNanoseconds() : 0) {}
+	~TraceZone()
+	{
+		if(begin)
+			TraceRecord(name, begin, GetTickNanoseconds());
+	}
+};
+
+void TraceStart()
+{
+	trace.enabled = true;
+	trace.start = GetTickNanoseconds();
+	TraceSetThreadName(TEXT("Frame loop"));
+	trace.gpu = TraceCreateTrack(TEXT("Present queue"), true);
+}
+
+//Matches the device clock with GetTickNanoseconds, both clocks drift so it is repeated while tracing
+void TraceCalibrateGpu(const VulkanDeviceDispatch& vkd, VkDevice device)
+{
+	VkCalibratedTimestampInfoEXT infos[2] = {{VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr, VK_TIME_DOMAIN_DEVICE_EXT}, {VK_STRUCTURE_TYPE_CALIBRATED_TIMESTAMP_INFO_EXT, nullptr, HOST_TIME_DOMAIN}};
+	uint64_t timestamps[2];
+	uint64_t maxDeviation;
+	VK_ASSERT(vkd.vkGetCalibratedTimestampsEXT(device, 2, infos, timestamps, &maxDeviation));
+	trace.gpuTicks = timestamps[0];
+	trace.gpuHostNanoseconds = HostTicksToNanoseconds(static_cast<int64_t>(timestamps[1]));
+	trace.gpuCalibrated = true;
+}
+
+//Places the zones of the frame the profiler read back last on the GPU track
+void TraceGpuFrame(const GpuProfiler& profiler)
+{
+	if(!trace.enabled || !trace.gpuCalibrated)
+		return;
+
+	//Timestamps only have timestampValidBits, the difference to the calibration tick wraps around within the mask
+	auto toHost = [](uint64_t ticks) -> int64_t {
+		uint64_t delta = (ticks - trace.gpuTicks) & trace.timestampMask;
+		auto signedDelta = static_cast<int64_t>(delta);
+		if(trace.timestampMask != UINT64_MAX && delta > trace.timestampMask >> 1)
+			signedDelta -= static_cast<int64_t>(trace.timestampMask) + 1;
+		return trace.gpuHostNanoseconds + static_cast<int64_t>(signedDelta * trace.timestampPeriod);
+	};
+	for(uint32_t i = 0; i < profiler.resolvedZoneCount; ++i)
+		TraceRecord(trace.gpu, profiler.zoneNames[i], toHost(profiler.resolvedTimestamps[i * 2]), toHost(profiler.resolvedTimestamps[i * 2 + 1]));
+}
+
+//Writes the Chrome trace JSON and releases the buffers, call once every thread that recorded has joined
+void TraceStop(const char* path)
+{
+	if(!trace.enabled)
+		return;
+	trace.enabled = false;
+
+	TOFSTREAM file(path);
+	if(!file)
+		Abort(TEXT("Failed to create the trace file"));
+	file << std::fixed << std::setprecision(3);
+
+	//Chrome trace timestamps are microseconds, CPU threads and the GPU are shown as two processes
+	auto us = [](int64_t nanoseconds) -> double { return (nanoseconds - trace.start) / 1e3; };
+	uint64_t eventCount = 0, droppedCount = 0;
+	file << TEXT("{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+	file << TEXT("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"CPU\"}},\n");
+	file << TEXT("{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 2, \"args\": {\"name\": \"GPU\"}}");
+	for(TraceBuffer* buffer = trace.buffers.load(std::memory_order_acquire); buffer; buffer = buffer->next) {
+		int pid = buffer->gpu ? 2 : 1;
+		file << TEXT(",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": ") << pid << TEXT(", \"tid\": ") << buffer->trackId << TEXT(", \"args\": {\"name\": \"") << buffer->trackName << TEXT("\"}}");
+		uint32_t count = buffer->count.load(std::memory_order_acquire);
+		for(uint32_t i = 0; i < count; ++i) {
+			auto& event = buffer->events[i];
+			file << TEXT(",\n{\"name\": \"") << event.name << TEXT("\", \"ph\": \"X\", \"pid\": ") << pid << TEXT(", \"tid\": ") << buffer->trackId << TEXT(", \"ts\": ") << us(event.begin) << TEXT(", \"dur\": ") << (event.end - event.begin) / 1e3 << TEXT("}");
+		}
+		eventCount += count;
+		droppedCount += buffer->dropped;
+	}
+	file << TEXT("\n]}\n");
+	if(!file)
+		Abort(TEXT("Failed to write the trace file"));
+
+	for(TraceBuffer* buffer = trace.buffers.exchange(nullptr); buffer;) {
+		TraceBuffer* next = buffer->next;
+		delete buffer;
+		buffer = next;
+	}
+	trace.gpu = nullptr;
+	TCOUT << TEXT("Trace events: ") << eventCount << TEXT(", dropped: ") << droppedCount << std::endl;
+}
+
+//Parallel recording
+//Splits the draws of a render pass across threads that record them into secondary command buffers, which the frame's
+//primary command buffer runs with vkCmdExecuteCommands. Every recorder owns a command pool per frame in flight and
+//resets it itself when it starts the frame's job, so no pool is ever touched by two threads and recording never locks.
+//The thread that posts the job is recorder 0 and records its share while the workers record theirs, the workers sleep
+//on a condition variable in between. A job is only posted for a frame slot whose last submission is complete.
+#define RECORD_MAX_THREADS 64
+
+struct RecorderPool {
+	VkCommandPool commandPool;
+	VkCommandBuffer commandBuffer; //secondary
+};
+
+struct Recorder {
+	RecorderPool pools[MAX_FRAMES_IN_FLIGHT];
+	std::thread thread; //none for recorder 0
+	VkCommandBuffer recorded; //of the last job, null when it got no items
+	int64_t busyNanoseconds; //since the last summary, written by the recorder's thread only
+};
+
+struct ParallelRecorder {
+	const VulkanDeviceDispatch* vkd;
+	VkDevice device;
+	std::vector<Recorder> recorders; //empty when disabled
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	uint64_t generation; //of the current job
+	uint32_t pending; //workers still recording it
+	bool stop;
+	//Current job
+	uint32_t frameSlot;
+	VkCommandBufferInheritanceInfo inheritance;
+	uint32_t itemCount;
+	const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>* record;
+	uint64_t jobs; //since the last summary
+};
+
+//Records the share of items of recorder index into its secondary command buffer of the job's frame slot
+void ParallelRecordShare(ParallelRecorder& recorder, uint32_t index)
+{
+	auto& self = recorder.recorders[index];
+	uint32_t recorderCount = static_cast<uint32_t>(recorder.recorders.size());
+	uint32_t first = static_cast<uint32_t>(static_cast<uint64_t>(recorder.itemCount) * index / recorderCount);
+	uint32_t end = static_cast<uint32_t>(static_cast<uint64_t>(recorder.itemCount) * (index + 1) / recorderCount);
+	self.recorded = VK_NULL_HANDLE;
+	if(first == end)
+		return;
+
+	TraceZone zone(TEXT("record share"));
+	auto start = GetTickNanoseconds();
+	auto& vkd = *recorder.vkd;
+	auto& pool = self.pools[recorder.frameSlot];
+	VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, &recorder.inheritance};
+	VK_ASSERT(vkd.vkResetCommandPool(recorder.device, pool.commandPool, 0));
+	VK_ASSERT(vkd.vkBeginCommandBuffer(pool.commandBuffer, &commandBufferBeginInfo));
+	(*recorder.record)(pool.commandBuffer, first, end - first);
+	VK_ASSERT(vkd.vkEndCommandBuffer(pool.commandBuffer));
+	self.recorded = pool.commandBuffer;
+	self.busyNanoseconds += GetTickNanoseconds() - start;
+}
+
+void ParallelRecorderWorker(ParallelRecorder* recorder, uint32_t index)
+{
+	TCHAR name[32];
+	_stprintf_s(name, 32, TEXT("Recorder %u"), index);
+	TraceSetThreadName(name);
+	uint64_t generation = 0;
+	for(;;) {
+		{
+			std::unique_lock<std::mutex> lock(recorder->mutex);
+			recorder->wake.wait(lock, [&]() { return recorder->stop || recorder->generation != generation; });
+			if(recorder->stop)
+				return;
+			generation = recorder->generation;
+		}
+		ParallelRecordShare(*recorder, index);
+		{
+			std::lock_guard<std::mutex> lock(recorder->mutex);
+			if(--recorder->pending == 0)
+				recorder->done.notify_one();
+		}
+	}
+}
+
+//recorderCount recorders, the calling thread included, with a pool per frame in flight of queueFamilyIndex
+//In place, the recorder holds the mutex its workers share
+void CreateParallelRecorder(const VulkanDeviceDispatch& vkd, VkDevice device, ParallelRecorder& recorder, uint32_t recorderCount, uint32_t frameCount, uint32_t queueFamilyIndex)
+{
+	ASSERT(recorderCount >= 1 && recorderCount <= RECORD_MAX_THREADS);
+	recorder.vkd = &vkd;
+	recorder.device = device;
+	recorder.recorders = std::vector<Recorder>(recorderCount);
+	recorder.generation = 0;
+	recorder.pending = 0;
+	recorder.stop = false;
+	recorder.jobs = 0;
+	for(auto& self : recorder.recorders) {
+		for(uint32_t i = 0; i < frameCount; ++i) {
+			auto& pool = self.pools[i];
+			VkCommandPoolCreateInfo cpci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+			cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			cpci.queueFamilyIndex = queueFamilyIndex;
+			VK_ASSERT(vkd.vkCreateCommandPool(device, &cpci, allocator, &pool.commandPool));
+			VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
+			ai.commandPool = pool.commandPool;
+			ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			ai.commandBufferCount = 1;
+			VK_ASSERT(vkd.vkAllocateCommandBuffers(device, &ai, &pool.commandBuffer));
+		}
+		self.recorded = VK_NULL_HANDLE;
+		self.busyNanoseconds = 0;
+	}
+	for(uint32_t i = 1; i < recorderCount; ++i)
+		recorder.recorders[i].thread = std::thread(ParallelRecorderWorker, &recorder, i);
+}
+
+//Call once every submission of the secondary command buffers is complete
+void DestroyParallelRecorder(const VulkanDeviceDispatch& vkd, VkDevice device, ParallelRecorder& recorder)
+{
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		recorder.stop = true;
+	}
+	recorder.wake.notify_all();
+	for(auto& self : recorder.recorders) {
+		if(self.thread.joinable())
+			self.thread.join();
+		for(auto& pool : self.pools)
+			if(pool.commandPool)
+				vkd.vkDestroyCommandPool(device, pool.commandPool, allocator);
+	}
+	recorder.recorders.clear();
+}
+
+//Records itemCount items into secondary command buffers that continue the render pass of inheritance, with
+//record(commandBuffer, first, count) called on every recorder for a contiguous share of the items
+//Writes the secondaries to commandBuffers in item order and returns their count, at most one per recorder
+uint32_t ParallelRecord(ParallelRecorder& recorder, uint32_t frameSlot, const VkCommandBufferInheritanceInfo& inheritance, uint32_t itemCount, const std::function<void(VkCommandBuffer, uint32_t, uint32_t)>& record, VkCommandBuffer* commandBuffers)
+{
+	{
+		std::lock_guard<std::mutex> lock(recorder.mutex);
+		recorder.frameSlot = frameSlot;
+		recorder.inheritance = inheritance;
+		recorder.itemCount = itemCount;
+		recorder.record = &record;
+		recorder.pending = static_cast<uint32_t>(recorder.recorders.size()) - 1;
+		++recorder.generation;
+	}
+	recorder.wake.notify_all();
+	ParallelRecordShare(recorder, 0);
+	{
+		std::unique_lock<std::mutex> lock(recorder.mutex);
+		recorder.done.wait(lock, [&]() { return recorder.pending == 0; });
+	}
+	++recorder.jobs;
+
+	uint32_t count = 0;
+	for(auto& self : recorder.recorders)
+		if(self.recorded)
+			commandBuffers[count++] = self.recorded;
+	return count;
+}
+
+//"Recording: 4 threads, 0.42 ms per job on the busiest, 1.61 ms in all", then restarts the sums
+int ParallelRecorderSummary(ParallelRecorder& recorder, TCHAR* buffer, size_t size)
+{
+	int64_t busiest = 0, total = 0;
+	for(auto& self : recorder.recorders) {
+		busiest = std::max(busiest, self.busyNanoseconds);
+		total += self.busyNanoseconds;
+		self.busyNanoseconds = 0;
+	}
+	double jobs = recorder.jobs ? static_cast<double>(recorder.jobs) : 1.0;
+	recorder.jobs = 0;
+	return _stprintf_s(buffer, size, TEXT("Recording: %u threads, %.3f ms per job on the busiest, %.3f ms in all"), static_cast<uint32_t>(recorder.recorders.size()), busiest / jobs / 1e6, total / jobs / 1e6);
+}
+
+enum class PresentPolicy {
+	PowerSave, //vsync, never tears
+	LowLatency, //newest frame wins, tears only as a last resort
+	MaxThroughput, //uncapped, for benchmarking
+};
+
+//How the frame is filled before the overlay is drawn
+enum class FillMode {
+	Clear, //vkCmdClearColorImage
+	RenderPass, //VK_ATTACHMENT_LOAD_OP_CLEAR of the overlay render pass, which also does the layout transitions
+	Compute, //compute shader in the frame's command buffer
+	AsyncCompute, //compute shader on a compute-only queue, in the frame when the device has none
+};
+
+struct Options {
+	uint32_t framesInFlight = 2;
+	bool resizeStress = false;
+	PresentPolicy presentPolicy = PresentPolicy::PowerSave;
+	bool headless = false;
+	uint32_t width = 640, height = 480;
+	uint64_t frameCount = 0; //0 runs until the window is closed
+	bool dispatchBenchmark = false;
+	bool allocationBenchmark = false;
+	uint32_t swapChainImageCount = 0; //0 picks 2, or 3 for mailbox
+	uint64_t warmupFrames = 0; //run before frameCount, excluded from the statistics
+	const char* benchmarkOutput = nullptr; //.json or .csv report of the measured frames
+	const char* benchmarkBaseline = nullptr; //.json report to compare against
+	double regressionThreshold = 5.0; //percent
+	const char* captureOutput = nullptr; //command stream capture file
+	uint32_t captureRingMegabytes = 64;
+	const char* replayInput = nullptr; //capture file to replay headless instead of rendering
+	const char* traceOutput = nullptr; //Chrome trace JSON of the CPU and GPU zones
+	bool pooledHostAllocator = false; //tracked VkAllocationCallbacks instead of the driver's own host allocations
+	bool asyncUploads = true; //on a dedicated transfer queue when the device has one
+	FillMode fill = FillMode::AsyncCompute;
+	bool synchronization2 = true; //vkCmdPipelineBarrier2KHR when the device supports it
+	const char* pipelineCache = "OneFileVulkan.pipelinecache"; //null keeps the cache in memory
+	uint32_t sceneDraws = 0; //quads drawn under the overlay, one draw each
+	uint32_t recordThreads = 0; //0 records the overlay pass inline, otherwise on secondary command buffers of that many threads
+	bool recordBenchmark = false;
+};
+
+//Command line:
+//	-frames <1..MAX_FRAMES_IN_FLIGHT> -resizestress -present <powersave|lowlatency|throughput>
+//	-headless -width <pixels> -height <pixels> -framecount <frames>
+//	-dispatchbench -allocbench -images <count> -warmup <frames>
+//	-benchmark <report.json|report.csv> -baseline <report.json> -threshold <percent>
+//	-capture <file> -capturering <megabytes> -replay <file> -trace <trace.json>
+//	-allocator <system|pooled> -uploads <transfer|frame> -fill <async|compute|clear|renderpass>
+//	-barriers <sync2|classic> -pipelinecache <file|none>
+//	-scene <draws> -recordthreads <0..RECORD_MAX_THREADS> -recordbench
+Options ParseOptions(int argc, char** argv)
+{
+	Options options;
+	bool presentPolicySet = false;
+
+	for(int i = 1; i < argc; ++i) {
+		if(strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			options.framesInFlight = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-dispatchbench") == 0)
+			options.dispatchBenchmark = true;
+		else if(strcmp(argv[i], "-allocbench") == 0)
+			options.allocationBenchmark = true;
+		else if(strcmp(argv[i], "-recordbench") == 0)
+			options.recordBenchmark = true;
+		else if(strcmp(argv[i], "-scene") == 0 && i + 1 < argc)
+			options.sceneDraws = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-recordthreads") == 0 && i + 1 < argc)
+			options.recordThreads = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-headless") == 0)
+			options.headless = true;
+		else if(strcmp(argv[i], "-width") == 0 && i + 1 < argc)
+			options.width = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-height") == 0 && i + 1 < argc)
+			options.height = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-framecount") == 0 && i + 1 < argc)
+			options.frameCount = static_cast<uint64_t>(strtoull(argv[++i], nullptr, 10));
+		else if(strcmp(argv[i], "-resizestress") == 0)
+			options.resizeStress = true;
+		else if(strcmp(argv[i], "-images") == 0 && i + 1 < argc)
+			options.swapChainImageCount = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-warmup") == 0 && i + 1 < argc)
+			options.warmupFrames = static_cast<uint64_t>(strtoull(argv[++i], nullptr, 10));
+		else if(strcmp(argv[i], "-benchmark") == 0 && i + 1 < argc)
+			options.benchmarkOutput = argv[++i];
+		else if(strcmp(argv[i], "-baseline") == 0 && i + 1 < argc)
+			options.benchmarkBaseline = argv[++i];
+		else if(strcmp(argv[i], "-threshold") == 0 && i + 1 < argc)
+			options.regressionThreshold = atof(argv[++i]);
+		else if(strcmp(argv[i], "-capture") == 0 && i + 1 < argc)
+			options.captureOutput = argv[++i];
+		else if(strcmp(argv[i], "-capturering") == 0 && i + 1 < argc)
+			options.captureRingMegabytes = static_cast<uint32_t>(atoi(argv[++i]));
+		else if(strcmp(argv[i], "-replay") == 0 && i + 1 < argc)
+			options.replayInput = argv[++i];
+		else if(strcmp(argv[i], "-trace") == 0 && i + 1 < argc)
+			options.traceOutput = argv[++i];
+		else if(strcmp(argv[i], "-allocator") == 0 && i + 1 < argc) {
+			const char* hostAllocator = argv[++i];
+			if(strcmp(hostAllocator, "system") == 0)
+				options.pooledHostAllocator = false;
+			else if(strcmp(hostAllocator, "pooled") == 0)
+				options.pooledHostAllocator = true;
+			else
+				Abort(TEXT("-allocator must be system or pooled"));
+		}
+		else if(strcmp(argv[i], "-uploads") == 0 && i + 1 < argc) {
+			const char* uploads = argv[++i];
+			if(strcmp(uploads, "transfer") == 0)
+				options.asyncUploads = true;
+			else if(strcmp(uploads, "frame") == 0)
+				options.asyncUploads = false;
+			else
+				Abort(TEXT("-uploads must be transfer or frame"));
+		}
+		else if(strcmp(argv[i], "-fill") == 0 && i + 1 < argc) {
+			const char* fill = argv[++i];
+			if(strcmp(fill, "async") == 0)
+				options.fill = FillMode::AsyncCompute;
+			else if(strcmp(fill, "compute") == 0)
+				options.fill = FillMode::Compute;
+			else if(strcmp(fill, "clear") == 0)
+				options.fill = FillMode::Clear;
+			else if(strcmp(fill, "renderpass") == 0)
+				options.fill = FillMode::RenderPass;
+			else
+				Abort(TEXT("-fill must be async, compute, clear or renderpass"));
+		}
+		else if(strcmp(argv[i], "-barriers") == 0 && i + 1 < argc) {
+			const char* barriers = argv[++i];
+			if(strcmp(barriers, "sync2") == 0)
+				options.synchronization2 = true;
+			else if(strcmp(barriers, "classic") == 0)
+				options.synchronization2 = false;
+			else
+				Abort(TEXT("-barriers must be sync2 or classic"));
+		}
+		else if(strcmp(argv[i], "-pipelinecache") == 0 && i + 1 < argc) {
+			options.pipelineCache = argv[++i];
+			if(strcmp(options.pipelineCache, "none") == 0)
+				options.pipelineCache = nullptr;
+		}
+		else if(strcmp(argv[i], "-present") == 0 && i + 1 < argc) {
+			presentPolicySet = true;
+			const char* policy = argv[++i];
+			if(strcmp(policy, "powersave") == 0)
+				options.presentPolicy = PresentPolicy::PowerSave;
+			else if(strcmp(policy, "lowlatency") == 0)
+				options.presentPolicy = PresentPolicy::LowLatency;
+			else if(strcmp(policy, "throughput") == 0)
+				options.presentPolicy = PresentPolicy::MaxThroughput;
+			else
+				Abort(TEXT("-present must be powersave, lowlatency or throughput"));
+		}
+	}
+
+	if(options.framesInFlight < 1 || options.framesInFlight > MAX_FRAMES_IN_FLIGHT)
+		Abort(TEXT("-frames must be between 1 and MAX_FRAMES_IN_FLIGHT"));
+	if(options.width == 0 || options.height == 0)
+		Abort(TEXT("-width and -height must be greater than 0"));
+	//Replay runs windowless and as fast as possible unless told otherwise, the capture has the frame count
+	if(options.replayInput) {
+		options.headless = true;
+		if(!presentPolicySet)
+			options.presentPolicy = PresentPolicy::MaxThroughput;
+	}
+	if(options.replayInput && options.captureOutput)
+		Abort(TEXT("-capture and -replay are exclusive"));
+	if(options.captureRingMegabytes == 0)
+		Abort(TEXT("-capturering must be greater than 0"));
+	if(options.headless && options.resizeStress)
+		Abort(TEXT("-resizestress requires a window"));
+	//Headless runs have no window to close
+	if(options.headless && options.frameCount == 0 && !options.replayInput)
+		Abort(TEXT("-headless requires -framecount"));
+	//A benchmark measures a fixed workload
+	if(options.benchmarkOutput && options.frameCount == 0 && !options.replayInput)
+		Abort(TEXT("-benchmark requires -framecount or -replay"));
+	if(options.benchmarkBaseline && !options.benchmarkOutput)
+		Abort(TEXT("-baseline requires -benchmark"));
+	if(options.regressionThreshold < 0.0)
+		Abort(TEXT("-threshold must be positive"));
+	if(options.sceneDraws > SCENE_MAX_DRAWS)
+		Abort(TEXT("-scene must be at most SCENE_MAX_DRAWS"));
+	if(options.recordThreads > RECORD_MAX_THREADS)
+		Abort(TEXT("-recordthreads must be at most RECORD_MAX_THREADS"));
+	//Captures hold the clear and the overlay only
+	if(options.sceneDraws && (options.captureOutput || options.replayInput))
+		Abort(TEXT("-scene cannot be combined with -capture or -replay"));
+	if(options.recordBenchmark && !options.sceneDraws)
+		Abort(TEXT("-recordbench requires -scene"));
+	//Every thread count starts new threads, each would keep a trace buffer until exit
+	if(options.recordBenchmark && options.traceOutput)
+		Abort(TEXT("-recordbench cannot be combined with -trace"));
+
+	return options;
+}
+
+//Picks the first mode of the policy's preference list that the surface supports.
+//VK_PRESENT_MODE_FIFO_KHR is required to be supported and ends every list.
+VkPresentModeKHR SelectPresentMode(PresentPolicy policy, const std::vector<VkPresentModeKHR>& supportedModes)
+{
+	static const VkPresentModeKHR powerSave[] = {VK_PRESENT_MODE_FIFO_KHR};
+	static const VkPresentModeKHR lowLatency[] = {VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
+	static const VkPresentModeKHR maxThroughput[] = {VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_FIFO_KHR};
+
+	const VkPresentModeKHR* begin;
+	const VkPresentModeKHR* end;
+	switch(policy) {
+		case PresentPolicy::LowLatency: begin = std::begin(lowLatency), end = std::end(lowLatency); break;
+		case PresentPolicy::MaxThroughput: begin = std::begin(maxThroughput), end = std::end(maxThroughput); break;
+		default: begin = std::begin(powerSave), end = std::end(powerSave); break;
+	}
+
+	for(auto it = begin; it != end; ++it)
+		if(std::find(supportedModes.cbegin(), supportedModes.cend(), *it) != supportedModes.cend())
+			return *it;
+
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+LPCTSTR GetPresentModeName(VkPresentModeKHR presentMode)
+{
+	switch(presentMode) {
+		case VK_PRESENT_MODE_IMMEDIATE_KHR: return TEXT("IMMEDIATE");
+		case VK_PRESENT_MODE_MAILBOX_KHR: return TEXT("MAILBOX");
+		case VK_PRESENT_MODE_FIFO_KHR: return TEXT("FIFO");
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return TEXT("FIFO_RELAXED");
+		default: return TEXT("UNKNOWN");
+	}
+}
+
+//As given to -fill
+LPCTSTR GetFillModeName(FillMode fill)
+{
+	switch(fill) {
+		case FillMode::Clear: return TEXT("clear");
+		case FillMode::RenderPass: return TEXT("renderpass");
+		case FillMode::Compute: return TEXT("compute");
+		case FillMode::AsyncCompute: return TEXT("async");
+		default: return TEXT("unknown");
+	}
+}
+
+static bool wndResized;
+
+//Benchmark report
+//Covers the measured frames of a fixed-length run. JSON replaces the file, CSV appends a row to it,
+//so a CI job can keep one CSV per machine and chart it commit after commit.
+struct BenchmarkReport {
+	const char* deviceName;
+	uint32_t width, height;
+	LPCTSTR presentModeName;
+	LPCTSTR fillModeName;
+	uint32_t sceneDraws;
+	uint32_t recordThreads; //0 when recorded inline
+	uint32_t swapChainImageCount;
+	uint32_t framesInFlight;
+	uint64_t warmupFrames;
+	uint64_t measuredFrames;
+	double seconds;
+	uint64_t peakMemoryBytes;
+	const FrameStats* frameStats;
+	const GpuProfiler* gpuProfiler;
+};
+
+//Peak resident memory of the process
+uint64_t GetPeakMemoryBytes()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS pmc{};
+	WIN32_ASSERT(GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc)));
+	return pmc.PeakWorkingSetSize;
+#else
+	rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return static_cast<uint64_t>(usage.ru_maxrss) * 1024; //kilobytes on Linux
+#endif
+}
+
+bool EndsWith(const char* text, const char* suffix)
+{
+	size_t textLength = strlen(text), suffixLength = strlen(suffix);
+	return textLength >= suffixLength && strcmp(text + textLength - suffixLength, suffix) == 0;
+}
+
+double BenchmarkFps(const BenchmarkReport& report)
+{
+	return report.seconds > 0.0 ? report.measuredFrames / report.seconds : 0.0;
+}
+
+void WriteBenchmarkReport(const BenchmarkReport& report, const char* path)
+{
+	FrameStatsRow rows[FRAME_STATS_ROWS];
+	GetFrameStatsRows(*report.frameStats, rows);
+	const GpuProfiler& profiler = *report.gpuProfiler;
+	auto gpuMilliseconds = [&](uint32_t zone) -> double { return profiler.totalResolvedFrames ? profiler.zoneTotalMilliseconds[zone] / profiler.totalResolvedFrames : 0.0; };
+	auto ms = [](uint64_t nanoseconds) -> double { return nanoseconds / 1e6; };
+
+	if(EndsWith(path, ".csv")) {
+		bool header;
+		{
+			std::ifstream existing(path);
+			header = !existing || existing.peek() == std::ifstream::traits_type::eof();
+		}
+		TOFSTREAM file(path, std::ios::app);
+		if(!file)
+			Abort(TEXT("Failed to open the benchmark report"));
+		file << std::fixed << std::setprecision(4);
+
+		if(header) {
+			file << TEXT("device,width,height,present_mode,fill,scene_draws,record_threads,swapchain_images,frames_in_flight,warmup_frames,measured_frames,seconds,fps,peak_memory_bytes");
+			for(auto& row : rows)
+				file << TEXT(",") << row.key << TEXT("_mean_ms,") << row.key << TEXT("_p50_ms,") << row.key << TEXT("_p90_ms,") << row.key << TEXT("_p99_ms,") << row.key << TEXT("_max_ms");
+			for(uint32_t i = 0; i < profiler.zoneCount; ++i) {
+				file << TEXT(",gpu_");
+				for(LPCTSTR c = profiler.zoneNames[i]; *c; ++c)
+					file << (*c == ' ' ? TEXT('_') : *c);
+				file << TEXT("_ms");
+			}
+			file << std::endl;
+		}
+
+		file << report.deviceName << TEXT(",") << report.width << TEXT(",") << report.height << TEXT(",") << report.presentModeName << TEXT(",") << report.fillModeName << TEXT(",") << report.sceneDraws << TEXT(",") << report.recordThreads << TEXT(",") << report.swapChainImageCount << TEXT(",") << report.framesInFlight << TEXT(",")
+		     << report.warmupFrames << TEXT(",") << report.measuredFrames << TEXT(",") << report.seconds << TEXT(",") << BenchmarkFps(report) << TEXT(",") << report.peakMemoryBytes;
+		for(auto& row : rows)
+			file << TEXT(",") << ms(HistogramMean(*row.histogram)) << TEXT(",") << ms(HistogramPercentile(*row.histogram, 0.50)) << TEXT(",") << ms(HistogramPercentile(*row.histogram, 0.90)) << TEXT(",") << ms(HistogramPercentile(*row.histogram, 0.99)) << TEXT(",") << ms(row.histogram->max.load(std::memory_order_relaxed));
+		for(uint32_t i = 0; i < profiler.zoneCount; ++i)
+			file << TEXT(",") << gpuMilliseconds(i);
+		file << std::endl;
+		if(!file)
+			Abort(TEXT("Failed to write the benchmark report"));
+	} else {
+		TOFSTREAM file(path);
+		if(!file)
+			Abort(TEXT("Failed to open the benchmark report"));
+		file << std::fixed << std::setprecision(4);
+
+		file << TEXT("{\n");
+		file << TEXT("\t\"application\": \"") << TEXT(APPLICATION_NAME) << TEXT("\",\n");
+		file << TEXT("\t\"device\": \"") << report.deviceName << TEXT("\",\n");
+		file << TEXT("\t\"width\": ") << report.width << TEXT(",\n");
+		file << TEXT("\t\"height\": ") << report.height << TEXT(",\n");
+		file << TEXT("\t\"present_mode\": \"") << report.presentModeName << TEXT("\",\n");
+		file << TEXT("\t\"fill\": \"") << report.fillModeName << TEXT("\",\n");
+		file << TEXT("\t\"scene_draws\": ") << report.sceneDraws << TEXT(",\n");
+		file << TEXT("\t\"record_threads\": ") << report.recordThreads << TEXT(",\n");
+		file << TEXT("\t\"swapchain_images\": ") << report.swapChainImageCount << TEXT(",\n");
+		file << TEXT("\t\"frames_in_flight\": ") << report.framesInFlight << TEXT(",\n");
+		file << TEXT("\t\"warmup_frames\": ") << report.warmupFrames << TEXT(",\n");
+		file << TEXT("\t\"measured_frames\": ") << report.measuredFrames << TEXT(",\n");
+		file << TEXT("\t\"seconds\": ") << report.seconds << TEXT(",\n");
+		file << TEXT("\t\"fps\": ") << BenchmarkFps(report) << TEXT(",\n");
+		file << TEXT("\t\"peak_memory_bytes\": ") << report.peakMemoryBytes << TEXT(",\n");
+		file << TEXT("\t\"cpu_ms\": {\n");
+		for(uint32_t i = 0; i < FRAME_STATS_ROWS; ++i) {
+			auto& histogram = *rows[i].histogram;
+			file << TEXT("\t\t\"") << rows[i].key << TEXT("\": {\"mean\": ") << ms(HistogramMean(histogram)) << TEXT(", \"p50\": ") << ms(HistogramPercentile(histogram, 0.50)) << TEXT(", \"p90\": ") << ms(HistogramPercentile(histogram, 0.90))
+			     << TEXT(", \"p99\": ") << ms(HistogramPercentile(histogram, 0.99)) << TEXT(", \"max\": ") << ms(histogram.max.load(std::memory_order_relaxed)) << TEXT(", \"count\": ") << histogram.count.load(std::memory_order_relaxed) << TEXT("}")
+			     << (i + 1 < FRAME_STATS_ROWS ? TEXT(",\n") : TEXT("\n"));
+		}
+		file << TEXT("\t},\n");
+		file << TEXT("\t\"gpu_ms\": {");
+		for(uint32_t i = 0; i < profiler.zoneCount; ++i)
+			file << (i ? TEXT(", \"") : TEXT("\"")) << profiler.zoneNames[i] << TEXT("\": ") << gpuMilliseconds(i);
+		file << TEXT("}\n");
+		file << TEXT("}\n");
+		if(!file)
+			Abort(TEXT("Failed to write the benchmark report"));
+	}
+}
+
+//Finds "key": after "section": in a report written by WriteBenchmarkReport, -1 when missing
+double BenchmarkReportValue(const std::string& json, const char* section, const char* key)
+{
+	size_t position = 0;
+	if(section) {
+		position = json.find(std::string("\"") + section + "\":");
+		if(position == std::string::npos)
+			return -1.0;
+	}
+	position = json.find(std::string("\"") + key + "\":", position);
+	if(position == std::string::npos)
+		return -1.0;
+	return strtod(json.c_str() + position + strlen(key) + 3, nullptr);
+}
+
+//Compares throughput and frame time percentiles against a baseline JSON report
+//Returns false when any of them is worse by more than thresholdPercent
+bool CompareBenchmarkBaseline(const BenchmarkReport& report, const char* path, double thresholdPercent)
+{
+	std::ifstream file(path);
+	if(!file)
+		Abort(TEXT("Failed to open the benchmark baseline"));
+	std::string json((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+	const Histogram& frameTime = report.frameStats->frameTime;
+	const struct {
+		LPCTSTR name;
+		double baseline;
+		double current;
+		bool higherIsBetter;
+	} metrics[] = {
+		{TEXT("fps"), BenchmarkReportValue(json, nullptr, "fps"), BenchmarkFps(report), true},
+		{TEXT("frame_time p50 ms"), BenchmarkReportValue(json, "frame_time", "p50"), HistogramPercentile(frameTime, 0.50) / 1e6, false},
+		{TEXT("frame_time p99 ms"), BenchmarkReportValue(json, "frame_time", "p99"), HistogramPercentile(frameTime, 0.99) / 1e6, false},
+	};
+
+	bool passed = true;
+	for(auto& metric : metrics) {
+		if(metric.baseline <= 0.0)
+			Abort(TEXT("The benchmark baseline is missing fps or frame_time percentiles"));
+		double change = (metric.current - metric.baseline) * 100.0 / metric.baseline;
+		double regression = metric.higherIsBetter ? -change : change;
+		bool failed = regression > thresholdPercent;
+		TCOUT << metric.name << TEXT(": ") << metric.current << TEXT(" (baseline ") << metric.baseline << TEXT(", ") << (change >= 0.0 ? TEXT("+") : TEXT("")) << change << TEXT("%)") << (failed ? TEXT(" REGRESSION") : TEXT("")) << std::endl;
+		passed = passed && !failed;
+	}
+	return passed;
+}
+
+//Command stream capture
+//Everything the frame loop sends to Vulkan is serialized as records into a ring buffer allocated up
+//front. A writer thread drains the ring to the file, so the frame loop never blocks on I/O. A frame
+//is published whole once presented, and a frame that does not fit in the ring is dropped and counted
+//rather than stalling, so the capture can stay on in production.
+//File: CaptureHeader, then records, each a CaptureRecord followed by its payload padded to 4 bytes.
+//A Frame record starts every frame. Overlay vertices are only stored when they change.
+#define CAPTURE_MAGIC 0x4356464F //"OFVC"
+#define CAPTURE_VERSION 1
+
+enum class CaptureRecordType : uint32_t {
+	Frame = 1, //CaptureFrame
+	Extent, //VkExtent2D, the swap chain extent changed
+	ImageBarrier, //CaptureImageBarrier, on the acquired image
+	ClearColorImage, //VkClearColorValue, on the acquired image
+	OverlayVertices, //uint32_t vertex count, then the vertices
+	OverlayDraw, //uint32_t vertex count, the overlay render pass with the last stored vertices
+	Submit, //VkPipelineStageFlags the acquire semaphore is waited at
+	Present, //no payload
+};
+
+struct CaptureHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t reserved;
+	uint64_t frameCount; //written when the capture is closed
+	uint64_t droppedFrames;
+};
+
+struct CaptureRecord {
+	CaptureRecordType type;
+	uint32_t size; //payload bytes, before padding
+};
+
+struct CaptureFrame {
+	uint64_t frameNumber;
+	uint32_t imageIndex;
+	uint32_t reserved;
+};
+
+struct CaptureImageBarrier {
+	VkPipelineStageFlags srcStageMask;
+	VkPipelineStageFlags dstStageMask;
+	VkAccessFlags srcAccessMask;
+	VkAccessFlags dstAccessMask;
+	VkImageLayout oldLayout;
+	VkImageLayout newLayout;
+};
+
+struct Capture {
+	bool enabled;
+	std::ofstream file;
+	uint8_t* ring;
+	uint64_t capacity;
+	std::atomic<uint64_t> head; //published end of the last whole frame, frame loop only
+	std::atomic<uint64_t> tail; //end of the bytes on disk, writer thread only
+	std::atomic<bool> stop;
+	std::thread writer;
+	uint64_t cursor; //end of the frame being recorded
+	bool frameDropped;
+	uint64_t frameCount;
+	uint64_t droppedFrames;
+	//Change tracking, reset when a frame is dropped so the next one is self contained
+	VkExtent2D extent;
+	std::vector<OverlayVertex> overlayVertices;
+	bool overlayVerticesValid;
+};
+
+void CaptureWriter(Capture* capture)
+{
+	TraceSetThreadName(TEXT("Capture writer"));
+	for(;;) {
+		uint64_t head = capture->head.load(std::memory_order_acquire);
+		uint64_t tail = capture->tail.load(std::memory_order_relaxed);
+		if(head == tail) {
+			if(capture->stop.load(std::memory_order_acquire) && capture->head.load(std::memory_order_acquire) == tail)
+				return;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+		TraceZone zone(TEXT("capture write"));
+		uint64_t begin = tail % capture->capacity;
+		uint64_t size = head - tail;
+		uint64_t first = std::min(size, capture->capacity - begin);
+		capture->file.write(reinterpret_cast<const char*>(capture->ring + begin), static_cast<std::streamsize>(first));
+		if(size > first)
+			capture->file.write(reinterpret_cast<const char*>(capture->ring), static_cast<std::streamsize>(size - first));
+		capture->tail.store(head, std::memory_order_release);
+	}
+}
+
+void CaptureOpen(Capture& capture, const char* path, uint64_t capacity)
+{
+	capture.file.open(path, std::ios::binary | std::ios::trunc);
+	if(!capture.file)
+		Abort(TEXT("Failed to create the capture file"));
+	CaptureHeader header = {CAPTURE_MAGIC, CAPTURE_VERSION, VK_FORMAT_B8G8R8A8_UNORM, 0, 0, 0};
+	capture.file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+	capture.ring = static_cast<uint8_t*>(malloc(static_cast<size_t>(capacity)));
+	if(!capture.ring)
+		Abort(TEXT("Failed to allocate the capture ring"));
+	memset(capture.ring, 0, static_cast<size_t>(capacity)); //commit the pages now rather than during the first frames
+	capture.capacity = capacity;
+	capture.head = 0;
+	capture.tail = 0;
+	capture.stop = false;
+	capture.cursor = 0;
+	capture.frameDropped = false;
+	capture.frameCount = 0;
+	capture.droppedFrames = 0;
+	capture.extent = {};
+	capture.overlayVertices.reserve(OVERLAY_MAX_VERTICES);
+	capture.overlayVerticesValid = false;
+	capture.enabled = true;
+	capture.writer = std::thread(CaptureWriter, &capture);
+}
+
+//Drains the ring, then completes the header
+void CaptureClose(Capture& capture)
+{
+	if(!capture.enabled)
+		return;
+	capture.stop.store(true, std::memory_order_release);
+	capture.writer.join();
+
+	CaptureHeader header = {CAPTURE_MAGIC, CAPTURE_VERSION, VK_FORMAT_B8G8R8A8_UNORM, 0, capture.frameCount, capture.droppedFrames};
+	capture.file.seekp(0);
+	capture.file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	capture.file.close();
+	if(!capture.file)
+		Abort(TEXT("Failed to write the capture file"));
+	capture.enabled = false;
+	free(capture.ring);
+	capture.ring = nullptr;
+	TCOUT << TEXT("Captured frames: ") << capture.frameCount << TEXT(", dropped: ") << capture.droppedFrames << std::endl;
+}
+
+void CaptureCopy(Capture& capture, const void* data, uint32_t size)
+{
+	if(!size)
+		return;
+	uint64_t begin = capture.cursor % capture.capacity;
+	uint64_t first = std::min<uint64_t>(size, capture.capacity - begin);
+	memcpy(capture.ring + begin, data, static_cast<size_t>(first));
+	if(size > first)
+		memcpy(capture.ring, static_cast<const uint8_t*>(data) + first, static_cast<size_t>(size - first));
+	capture.cursor += size;
+}
+
+//Appends a record to the current frame, or drops the frame when the ring is full
+void CaptureWrite(Capture& capture, CaptureRecordType type, const void* payload, uint32_t size, const void* data = nullptr, uint32_t dataSize = 0)
+{
+	if(!capture.enabled || capture.frameDropped)
+		return;
+	uint32_t payloadSize = size + dataSize;
+	uint32_t padding = (4 - payloadSize % 4) % 4;
+	uint64_t used = capture.cursor + sizeof(CaptureRecord) + payloadSize + padding - capture.tail.load(std::memory_order_acquire);
+	if(used > capture.capacity) {
+		capture.frameDropped = true;
+		return;
+	}
+
+	const uint32_t zero = 0;
+	CaptureRecord record = {type, payloadSize};
+	CaptureCopy(capture, &record, sizeof(record));
+	CaptureCopy(capture, payload, size);
+	if(dataSize)
+		CaptureCopy(capture, data, dataSize);
+	CaptureCopy(capture, &zero, padding);
+}
+
+void CaptureBeginFrame(Capture& capture, uint64_t frameNumber, uint32_t imageIndex, VkExtent2D extent)
+{
+	if(!capture.enabled)
+		return;
+	capture.cursor = capture.head.load(std::memory_order_relaxed);
+	capture.frameDropped = false;
+	CaptureFrame frame = {frameNumber, imageIndex, 0};
+	CaptureWrite(capture, CaptureRecordType::Frame, &frame, sizeof(frame));
+	if(extent.width != capture.extent.width || extent.height != capture.extent.height) {
+		CaptureWrite(capture, CaptureRecordType::Extent, &extent, sizeof(extent));
+		capture.extent = extent;
+	}
+}
+
+void CaptureEndFrame(Capture& capture)
+{
+	if(!capture.enabled)
+		return;
+	if(capture.frameDropped) {
+		capture.extent = {};
+		capture.overlayVerticesValid = false;
+		++capture.droppedFrames;
+		return;
+	}
+	capture.head.store(capture.cursor, std::memory_order_release);
+	++capture.frameCount;
+}
+
+void CaptureOverlayDraw(Capture& capture, const OverlayVertex* vertices, uint32_t vertexCount)
+{
+	if(!capture.enabled)
+		return;
+	if(!capture.overlayVerticesValid || capture.overlayVertices.size() != vertexCount || memcmp(capture.overlayVertices.data(), vertices, vertexCount * sizeof(OverlayVertex))) {
+		CaptureWrite(capture, CaptureRecordType::OverlayVertices, &vertexCount, sizeof(vertexCount), vertices, vertexCount * sizeof(OverlayVertex));
+		capture.overlayVertices.assign(vertices, vertices + vertexCount);
+		capture.overlayVerticesValid = true;
+	}
+	CaptureWrite(capture, CaptureRecordType::OverlayDraw, &vertexCount, sizeof(vertexCount));
+}
+
+//Whole capture file in memory, so replay never waits on the disk
+struct Replay {
+	std::vector<uint8_t> data;
+	std::vector<size_t> frames; //offset of each Frame record
+};
+
+//Whether the record is of a known type and its payload has the size of that type, so replay can read it as is
+bool CaptureRecordSizeValid(const CaptureRecord& record, const uint8_t* payload)
 {
-	TCERR << TEXT("Vulkan operation failed") << std::endl;
-	TCERR << message << std::endl;
-	ExitProcess(result);
+	switch(record.type) {
+		case CaptureRecordType::Frame:
+			return record.size == sizeof(CaptureFrame);
+		case CaptureRecordType::Extent:
+			return record.size == sizeof(VkExtent2D);
+		case CaptureRecordType::ImageBarrier:
+			return record.size == sizeof(CaptureImageBarrier);
+		case CaptureRecordType::ClearColorImage:
+			return record.size == sizeof(VkClearColorValue);
+		case CaptureRecordType::OverlayVertices: {
+			uint32_t vertexCount;
+			if(record.size < sizeof(vertexCount))
+				return false;
+			memcpy(&vertexCount, payload, sizeof(vertexCount));
+			return vertexCount <= OVERLAY_MAX_VERTICES && record.size == sizeof(vertexCount) + vertexCount * sizeof(OverlayVertex);
+		}
+		case CaptureRecordType::OverlayDraw:
+			return record.size == sizeof(uint32_t);
+		case CaptureRecordType::Submit:
+			return record.size == sizeof(VkPipelineStageFlags);
+		case CaptureRecordType::Present:
+			return record.size == 0;
+	}
+	return false;
 }
 
-int64_t GetTick()
+void ReplayLoad(Replay& replay, const char* path)
 {
-	static LARGE_INTEGER frequency;
-	LARGE_INTEGER counter;
+	std::ifstream file(path, std::ios::binary);
+	if(!file)
+		Abort(TEXT("Failed to open the capture file"));
+	replay.data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
 
-	if(!frequency.QuadPart) {
-		QueryPerformanceFrequency(&frequency); //counts per second
-		frequency.QuadPart /= 1000; //counts per milliseconds
+	CaptureHeader header;
+	if(replay.data.size() < sizeof(header))
+		Abort(TEXT("The capture file is truncated"));
+	memcpy(&header, replay.data.data(), sizeof(header));
+	if(header.magic != CAPTURE_MAGIC || header.version != CAPTURE_VERSION || header.format != VK_FORMAT_B8G8R8A8_UNORM)
+		Abort(TEXT("The capture file is not a supported OneFileVulkan capture"));
+
+	for(size_t offset = sizeof(header); offset < replay.data.size();) {
+		CaptureRecord record;
+		if(replay.data.size() - offset < sizeof(record))
+			Abort(TEXT("The capture file is truncated"));
+		memcpy(&record, replay.data.data() + offset, sizeof(record));
+		size_t next = offset + sizeof(record) + (record.size + 3) / 4 * 4;
+		if(next > replay.data.size())
+			Abort(TEXT("The capture file is truncated"));
+		if(!CaptureRecordSizeValid(record, replay.data.data() + offset + sizeof(record)))
+			Abort(TEXT("The capture file has a record of an unknown type or the wrong size"));
+		if(record.type == CaptureRecordType::Frame)
+			replay.frames.push_back(offset);
+		else if(replay.frames.empty())
+			Abort(TEXT("The capture file does not start with a frame"));
+		offset = next;
 	}
+	if(replay.frames.empty())
+		Abort(TEXT("The capture file has no frames"));
+	TCOUT << TEXT("Replaying frames: ") << replay.frames.size() << TEXT(", dropped while capturing: ") << header.droppedFrames << std::endl;
+}
 
-	QueryPerformanceCounter(&counter);
+//Calls fn(type, payload, size) for each record of a frame, the Frame record included
+template<typename Fn>
+void ReplayFrameRecords(const Replay& replay, size_t frame, Fn fn)
+{
+	size_t offset = replay.frames[frame];
+	size_t end = frame + 1 < replay.frames.size() ? replay.frames[frame + 1] : replay.data.size();
+	while(offset < end) {
+		CaptureRecord record;
+		memcpy(&record, replay.data.data() + offset, sizeof(record));
+		fn(record.type, replay.data.data() + offset + sizeof(record), record.size);
+		offset += sizeof(record) + (record.size + 3) / 4 * 4;
+	}
+}
 
-	return counter.QuadPart / frequency.QuadPart;
+//Returns true once after the window client area changed size
+bool WndResized()
+{
+	bool resized = wndResized;
+	wndResized = false;
+	return resized;
 }
 
+#ifdef _WIN32
 LRESULT CALLBACK WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam)
 {
 	switch(msg) {
+		case WM_SIZE:
+			wndResized = true;
+			break;
 		case WM_KEYDOWN:
 			if(wParam == VK_ESCAPE) {
 				PostQuitMessage(0);
@@ -144,7 +4582,7 @@ Window CreateWnd(int width, int height)
 		WIN32_ASSERT(RegisterClass(&wc));
 	}
 
-	DWORD style = WS_BORDER | WS_CAPTION | WS_POPUP | WS_SYSMENU;
+	DWORD style = WS_BORDER | WS_CAPTION | WS_POPUP | WS_SYSMENU | WS_THICKFRAME | WS_MINIMIZEBOX | WS_MAXIMIZEBOX;
 	RECT rect{0, 0, width, height};
 	AdjustWindowRect(&rect, style, FALSE);
 
@@ -163,34 +4601,180 @@ void WndShow(const Window& window)
 	ShowWindow(window.hWnd, SW_SHOWNORMAL);
 }
 
-bool WndLoop()
+void WndResize(const Window& window, int width, int height)
+{
+	DWORD style = static_cast<DWORD>(GetWindowLongPtr(window.hWnd, GWL_STYLE));
+	RECT rect{0, 0, width, height};
+	AdjustWindowRect(&rect, style, FALSE);
+	SetWindowPos(window.hWnd, NULL, 0, 0, rect.right - rect.left, rect.bottom - rect.top, SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE);
+}
+
+void WndSetTitle(const Window& window, LPCTSTR title)
+{
+	SetWindowText(window.hWnd, title);
+}
+
+//Blocks until the next window message, used while there is nothing to render
+void WndWait(const Window&)
+{
+	WaitMessage();
+}
+
+//Drains every pending message without blocking
+bool WndLoop(Window&)
 {
+	TraceZone zone(TEXT("event pump"));
 	MSG msg;
+	bool running = true;
 	while(PeekMessage(&msg, 0, 0, 0, PM_REMOVE)) {
+		if(msg.message == WM_QUIT)
+			running = false;
 		DispatchMessage(&msg);
 	}
 
-	return msg.message != WM_QUIT;
+	return running;
+}
+#else
+struct Window {
+	xcb_connection_t* connection;
+	xcb_window_t window;
+	xcb_atom_t wmDeleteWindow;
+	int width, height;
+};
+
+Window CreateWnd(int width, int height)
+{
+	int screenIndex;
+	xcb_connection_t* connection = xcb_connect(nullptr, &screenIndex);
+	if(xcb_connection_has_error(connection))
+		Abort(TEXT("xcb_connect failed"));
+
+	auto screenIterator = xcb_setup_roots_iterator(xcb_get_setup(connection));
+	while(screenIndex-- > 0)
+		xcb_screen_next(&screenIterator);
+	xcb_screen_t* screen = screenIterator.data;
+
+	int x = (screen->width_in_pixels - width) >> 1;
+	int y = (screen->height_in_pixels - height) >> 1;
+	uint32_t values[] = {screen->black_pixel, XCB_EVENT_MASK_KEY_PRESS | XCB_EVENT_MASK_STRUCTURE_NOTIFY};
+	xcb_window_t window = xcb_generate_id(connection);
+	xcb_create_window(connection, XCB_COPY_FROM_PARENT, window, screen->root, static_cast<int16_t>(x), static_cast<int16_t>(y), static_cast<uint16_t>(width), static_cast<uint16_t>(height), 0, XCB_WINDOW_CLASS_INPUT_OUTPUT, screen->root_visual, XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK, values);
+
+	//Ask the window manager for a close message instead of having it kill the connection
+	auto protocolsCookie = xcb_intern_atom(connection, 1, 12, "WM_PROTOCOLS");
+	auto deleteWindowCookie = xcb_intern_atom(connection, 0, 16, "WM_DELETE_WINDOW");
+	xcb_intern_atom_reply_t* protocols = xcb_intern_atom_reply(connection, protocolsCookie, nullptr);
+	xcb_intern_atom_reply_t* deleteWindow = xcb_intern_atom_reply(connection, deleteWindowCookie, nullptr);
+	if(!protocols || !deleteWindow)
+		Abort(TEXT("xcb_intern_atom failed for WM_PROTOCOLS / WM_DELETE_WINDOW"));
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, protocols->atom, XCB_ATOM_ATOM, 32, 1, &deleteWindow->atom);
+	xcb_atom_t wmDeleteWindow = deleteWindow->atom;
+	free(protocols);
+	free(deleteWindow);
+
+	xcb_change_property(connection, XCB_PROP_MODE_REPLACE, window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, sizeof(APPLICATION_NAME) - 1, APPLICATION_NAME);
+
+	return {connection, window, wmDeleteWindow, width, height};
+}
+
+void WndShow(const Window& window)
+{
+	xcb_map_window(window.connection, window.window);
+	xcb_flush(window.connection);
+}
+
+void WndResize(const Window& window, int width, int height)
+{
+	uint32_t values[] = {static_cast<uint32_t>(width), static_cast<uint32_t>(height)};
+	xcb_configure_window(window.connection, window.window, XCB_CONFIG_WINDOW_WIDTH | XCB_CONFIG_WINDOW_HEIGHT, values);
+	xcb_flush(window.connection);
+}
+
+void WndSetTitle(const Window& window, LPCTSTR title)
+{
+	xcb_change_property(window.connection, XCB_PROP_MODE_REPLACE, window.window, XCB_ATOM_WM_NAME, XCB_ATOM_STRING, 8, static_cast<uint32_t>(strlen(title)), title);
+	xcb_flush(window.connection);
+}
+
+//Blocks until the next window event, used while there is nothing to render
+//WndLoop has drained the event queue, so readability of the socket is all there is left to wait on
+void WndWait(const Window& window)
+{
+	pollfd pfd{xcb_get_file_descriptor(window.connection), POLLIN, 0};
+	poll(&pfd, 1, -1);
+}
+
+//Drains every pending event without blocking
+//xcb_poll_for_event reads the socket at most once, when its queue is empty
+bool WndLoop(Window& window)
+{
+	TraceZone zone(TEXT("event pump"));
+	const xcb_keycode_t KEYCODE_ESCAPE = 9; //evdev and most X keymaps
+	bool running = true;
+	xcb_generic_event_t* event;
+	while((event = xcb_poll_for_event(window.connection))) {
+		switch(event->response_type & ~0x80) {
+			case XCB_KEY_PRESS:
+				if(reinterpret_cast<xcb_key_press_event_t*>(event)->detail == KEYCODE_ESCAPE)
+					running = false;
+				break;
+			case XCB_CONFIGURE_NOTIFY: {
+				auto configure = reinterpret_cast<xcb_configure_notify_event_t*>(event);
+				if(configure->width != window.width || configure->height != window.height) {
+					window.width = configure->width;
+					window.height = configure->height;
+					wndResized = true;
+				}
+				break;
+			}
+			case XCB_CLIENT_MESSAGE:
+				if(reinterpret_cast<xcb_client_message_event_t*>(event)->data.data32[0] == window.wmDeleteWindow)
+					running = false;
+				break;
+		}
+		free(event);
+	}
+
+	return running && !xcb_connection_has_error(window.connection);
 }
+#endif
 
-void OneFileVulkan()
+//Returns the process exit code, 2 when the benchmark regressed against its baseline
+int OneFileVulkan(const Options& options)
 {
+	auto startup_start = GetTickNanoseconds();
+
+	//Loaded up front, a bad capture fails before any Vulkan object exists
+	Replay replay;
+	if(options.replayInput)
+		ReplayLoad(replay, options.replayInput);
+	if(options.traceOutput)
+		TraceStart();
+	if(options.pooledHostAllocator)
+		allocator = HostAllocatorCallbacks();
+
+#ifdef _WIN32
 	HMODULE vulkan = LoadLibrary(TEXT("vulkan-1.dll"));
 	if(!vulkan)
-		return;
+		Win32Abort(TEXT("LoadLibrary vulkan-1.dll failed"));
+#else
+	void* vulkan = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
+	if(!vulkan)
+		DlAbort(TEXT("dlopen libvulkan.so.1 failed"));
+#endif
 
 	VK_LOAD_FROM_MODULE(vulkan, vkGetInstanceProcAddr);
-	VK_LOAD_FROM_VULKAN(vkEnumerateInstanceExtensionProperties);
-	VK_LOAD_FROM_VULKAN(vkCreateInstance);
+	VulkanGlobalDispatch vkg = LoadGlobalDispatch(vkGetInstanceProcAddr);
 
 	//Check available extensions
-	std::vector<const char*> instanceExtensions = {VK_KHR_SURFACE_EXTENSION_NAME, VK_KHR_WIN32_SURFACE_EXTENSION_NAME};
+	//Headless rendering goes through VK_EXT_headless_surface, the swap chain and frame loop are the same as with a window
+	std::vector<const char*> instanceExtensions = {VK_KHR_SURFACE_EXTENSION_NAME, options.headless ? VK_EXT_HEADLESS_SURFACE_EXTENSION_NAME : PLATFORM_SURFACE_EXTENSION_NAME};
 	{
 		uint32_t propertyCount;
-		VK_ASSERT(vkEnumerateInstanceExtensionProperties(nullptr, &propertyCount, nullptr));
+		VK_ASSERT(vkg.vkEnumerateInstanceExtensionProperties(nullptr, &propertyCount, nullptr));
 		ASSERT(propertyCount > 0);
 		std::vector<VkExtensionProperties> properties(propertyCount);
-		VK_ASSERT(vkEnumerateInstanceExtensionProperties(nullptr, &propertyCount, &properties.front()));
+		VK_ASSERT(vkg.vkEnumerateInstanceExtensionProperties(nullptr, &propertyCount, &properties.front()));
 		auto checkExtension = [&](const char* extensionName) -> bool { return properties.cend() != std::find_if(properties.cbegin(), properties.cend(), [&](auto& p) -> bool { return strcmp(extensionName, p.extensionName) == 0; }); };
 		for(auto& de : instanceExtensions) {
 			auto extensionPresent = checkExtension(de);
@@ -205,76 +4789,130 @@ void OneFileVulkan()
 	ai.applicationVersion = VK_MAKE_VERSION(0, 1, 0);
 	ai.pEngineName = ai.pApplicationName;
 	ai.engineVersion = ai.applicationVersion;
-	ai.apiVersion = VK_VERSION_1_2;
+	ai.apiVersion = VK_API_VERSION_1_2;
 	VkInstanceCreateInfo ci{};
 	ci.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
 	ci.pApplicationInfo = &ai;
 	ci.enabledExtensionCount = static_cast<uint32_t>(instanceExtensions.size());
 	ci.ppEnabledExtensionNames = &instanceExtensions.front();
 	VkInstance instance;
-	VK_ASSERT(vkCreateInstance(&ci, nullptr, &instance));
+	VK_ASSERT(vkg.vkCreateInstance(&ci, allocator, &instance));
 	ASSERT(instance);
 
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkEnumeratePhysicalDevices);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetPhysicalDeviceProperties2);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetPhysicalDeviceQueueFamilyProperties2);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetPhysicalDeviceSurfaceSupportKHR);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkCreateDevice);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetDeviceProcAddr);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkDestroyInstance);
+	VulkanInstanceDispatch vki = LoadInstanceDispatch(vkGetInstanceProcAddr, instance);
 
 	//Get First Physical Device
 	uint32_t physicalDeviceCount;
-	VK_ASSERT(vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr));
+	VK_ASSERT(vki.vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, nullptr));
 	ASSERT(physicalDeviceCount > 0);
 	auto physicalDevices = new VkPhysicalDevice[physicalDeviceCount];
-	VK_ASSERT(vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices));
+	VK_ASSERT(vki.vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices));
 	VkPhysicalDevice physicalDevice = physicalDevices[0];
 	delete[] physicalDevices;
 
+	//Check physical device version and features, timeline semaphores are core in Vulkan 1.2
+	VkPhysicalDeviceProperties2 physicalDeviceProperties{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+	vki.vkGetPhysicalDeviceProperties2(physicalDevice, &physicalDeviceProperties);
+	if(physicalDeviceProperties.properties.apiVersion < VK_API_VERSION_1_2)
+		Abort(TEXT("The physical device does not support Vulkan 1.2"));
+	VkPhysicalDeviceVulkan12Features physicalDeviceVulkan12Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+	VkPhysicalDeviceFeatures2 physicalDeviceFeatures{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &physicalDeviceVulkan12Features};
+	vki.vkGetPhysicalDeviceFeatures2(physicalDevice, &physicalDeviceFeatures);
+	if(!physicalDeviceVulkan12Features.timelineSemaphore)
+		Abort(TEXT("The physical device does not support timeline semaphores"));
+
 	//Check physical device available extensions
 	std::vector<const char*> physicalDeviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+	bool calibratedTimestamps = false;
+	bool memoryBudget = false;
+	bool synchronization2 = false;
 	{
-		VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkEnumerateDeviceExtensionProperties);
 		uint32_t propertyCount;
-		VK_ASSERT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &propertyCount, nullptr));
+		VK_ASSERT(vki.vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &propertyCount, nullptr));
 		ASSERT(propertyCount > 0);
 		std::vector<VkExtensionProperties> properties(propertyCount);
-		VK_ASSERT(vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &propertyCount, &properties.front()));
+		VK_ASSERT(vki.vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &propertyCount, &properties.front()));
 		auto checkExtension = [&](const char* extensionName) -> bool { return properties.cend() != std::find_if(properties.cbegin(), properties.cend(), [&](auto& p) -> bool { return strcmp(extensionName, p.extensionName) == 0; }); };
 		for(auto& de : physicalDeviceExtensions)
 			ASSERT(checkExtension(de));
+
+		//The GPU track of the trace needs the device clock and the clock of GetTickNanoseconds sampled together
+		if(options.traceOutput && checkExtension(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME) && vki.vkGetPhysicalDeviceCalibrateableTimeDomainsEXT) {
+			uint32_t timeDomainCount;
+			VK_ASSERT(vki.vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, nullptr));
+			std::vector<VkTimeDomainEXT> timeDomains(timeDomainCount);
+			VK_ASSERT(vki.vkGetPhysicalDeviceCalibrateableTimeDomainsEXT(physicalDevice, &timeDomainCount, timeDomains.data()));
+			calibratedTimestamps = std::find(timeDomains.begin(), timeDomains.end(), VK_TIME_DOMAIN_DEVICE_EXT) != timeDomains.end() && std::find(timeDomains.begin(), timeDomains.end(), HOST_TIME_DOMAIN) != timeDomains.end();
+			if(calibratedTimestamps)
+				physicalDeviceExtensions.push_back(VK_EXT_CALIBRATED_TIMESTAMPS_EXTENSION_NAME);
+		}
+		if(options.traceOutput && !calibratedTimestamps)
+			TCOUT << TEXT("VK_EXT_calibrated_timestamps is not available, the trace has no GPU track") << std::endl;
+
+		//Heap budgets from the driver, estimated from the heap sizes without it
+		memoryBudget = checkExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if(memoryBudget)
+			physicalDeviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+		//Barriers with per barrier stage masks, classic barriers without it
+		if(options.synchronization2 && checkExtension(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME)) {
+			VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+			VkPhysicalDeviceFeatures2 features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, &synchronization2Features};
+			vki.vkGetPhysicalDeviceFeatures2(physicalDevice, &features);
+			synchronization2 = synchronization2Features.synchronization2 == VK_TRUE;
+			if(synchronization2)
+				physicalDeviceExtensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		}
 	}
 
-	//Create a win32 window
-	auto wnd = CreateWnd(640, 480);
+	//Create a window
+	Window wnd{};
+	if(!options.headless)
+		wnd = CreateWnd(options.width, options.height);
 
-	//Create a win32 surface
+	//Create a window or headless surface
 	VkSurfaceKHR surface;
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkCreateWin32SurfaceKHR);
-	{
+	if(options.headless) {
+		VkHeadlessSurfaceCreateInfoEXT sci = {VK_STRUCTURE_TYPE_HEADLESS_SURFACE_CREATE_INFO_EXT};
+		VK_ASSERT(vki.vkCreateHeadlessSurfaceEXT(instance, &sci, allocator, &surface));
+		ASSERT(surface);
+	} else {
+#ifdef _WIN32
+		VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkCreateWin32SurfaceKHR);
 		VkWin32SurfaceCreateInfoKHR sci = {VK_STRUCTURE_TYPE_WIN32_SURFACE_CREATE_INFO_KHR};
 		sci.hinstance = wnd.hInstance;
 		sci.hwnd = wnd.hWnd;
-		VK_ASSERT(vkCreateWin32SurfaceKHR(instance, &sci, nullptr, &surface));
+		VK_ASSERT(vkCreateWin32SurfaceKHR(instance, &sci, allocator, &surface));
+#else
+		VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkCreateXcbSurfaceKHR);
+		VkXcbSurfaceCreateInfoKHR sci = {VK_STRUCTURE_TYPE_XCB_SURFACE_CREATE_INFO_KHR};
+		sci.connection = wnd.connection;
+		sci.window = wnd.window;
+		VK_ASSERT(vkCreateXcbSurfaceKHR(instance, &sci, allocator, &surface));
+#endif
 		ASSERT(surface);
 	}
 
 	//Find Queue Family Index for VK_QUEUE_GRAPHICS_BIT and for vkGetPhysicalDeviceSurfaceSupportKHR
+	//Also the families dedicated to transfers and to compute, which run beside the graphics queue
 	uint32_t graphicsQueueFamilyIndex = INT_MAX;
 	uint32_t presentQueueFamilyIndex = INT_MAX;
+	uint32_t transferQueueFamilyIndex = INT_MAX;
+	uint32_t computeQueueFamilyIndex = INT_MAX;
+	uint32_t presentQueueTimestampValidBits;
+	uint32_t computeQueueTimestampValidBits = 0;
 	{
 		uint32_t queueFamilyPropertyCount;
-		vkGetPhysicalDeviceQueueFamilyProperties2(physicalDevice, &queueFamilyPropertyCount, nullptr);
+		vki.vkGetPhysicalDeviceQueueFamilyProperties2(physicalDevice, &queueFamilyPropertyCount, nullptr);
 		ASSERT(queueFamilyPropertyCount > 0);
 		std::vector<VkQueueFamilyProperties2> queueFamilyProperties(queueFamilyPropertyCount, {VK_STRUCTURE_TYPE_QUEUE_FAMILY_PROPERTIES_2});
-		vkGetPhysicalDeviceQueueFamilyProperties2(physicalDevice, &queueFamilyPropertyCount, &queueFamilyProperties.front());
+		vki.vkGetPhysicalDeviceQueueFamilyProperties2(physicalDevice, &queueFamilyPropertyCount, &queueFamilyProperties.front());
 		bool supportGraphics;
 		VkBool32 supportKHR;
 		for(uint32_t i = 0; i < queueFamilyPropertyCount; ++i) {
 			auto& qfp = queueFamilyProperties[i].queueFamilyProperties;
 			supportGraphics = qfp.queueCount > 0 && qfp.queueFlags & VK_QUEUE_GRAPHICS_BIT;
-			VK_ASSERT(vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &supportKHR));
+			VK_ASSERT(vki.vkGetPhysicalDeviceSurfaceSupportKHR(physicalDevice, i, surface, &supportKHR));
 			if(supportGraphics && supportKHR) {
 				graphicsQueueFamilyIndex = presentQueueFamilyIndex = i;
 				break;
@@ -284,234 +4922,1252 @@ void OneFileVulkan()
 			if(supportKHR && presentQueueFamilyIndex == INT_MAX)
 				presentQueueFamilyIndex = i;
 		}
+		for(uint32_t i = 0; i < queueFamilyPropertyCount; ++i) {
+			auto& qfp = queueFamilyProperties[i].queueFamilyProperties;
+			if(qfp.queueCount == 0 || qfp.queueFlags & VK_QUEUE_GRAPHICS_BIT)
+				continue;
+			//Copy engines advertise VK_QUEUE_TRANSFER_BIT alone, compute queues may add it
+			if(qfp.queueFlags & VK_QUEUE_COMPUTE_BIT) {
+				if(computeQueueFamilyIndex == INT_MAX)
+					computeQueueFamilyIndex = i;
+			}
+			else if(qfp.queueFlags & VK_QUEUE_TRANSFER_BIT && transferQueueFamilyIndex == INT_MAX)
+				transferQueueFamilyIndex = i;
+		}
 		ASSERT(graphicsQueueFamilyIndex != INT_MAX && "Found no queue with VK_QUEUE_GRAPHICS_BIT");
 		ASSERT(presentQueueFamilyIndex != INT_MAX && "Found no queue with vkGetPhysicalDeviceSurfaceSupportKHR");
+		presentQueueTimestampValidBits = queueFamilyProperties[presentQueueFamilyIndex].queueFamilyProperties.timestampValidBits;
+		if(computeQueueFamilyIndex != INT_MAX)
+			computeQueueTimestampValidBits = queueFamilyProperties[computeQueueFamilyIndex].queueFamilyProperties.timestampValidBits;
+		if(!(queueFamilyProperties[presentQueueFamilyIndex].queueFamilyProperties.queueFlags & VK_QUEUE_GRAPHICS_BIT))
+			Abort(TEXT("Frames are recorded on the present queue, which does not support graphics"));
 	}
 
 	//Create Logical Device And Device Queue
+	//One queue per family, the dedicated ones only when found
 	VkDevice device;
-	VkQueue graphicsDeviceQueue, presentDeviceQueue;
+	VkQueue graphicsDeviceQueue, presentDeviceQueue, transferDeviceQueue = VK_NULL_HANDLE, computeDeviceQueue = VK_NULL_HANDLE;
 	{
 		float queue_priorities = 1.0f;
-		std::vector<VkDeviceQueueCreateInfo> qcis(2, {VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO});
-		qcis[0].queueFamilyIndex = graphicsQueueFamilyIndex;
-		qcis[0].queueCount = 1;
-		qcis[0].pQueuePriorities = &queue_priorities;
-		qcis[1].queueFamilyIndex = presentQueueFamilyIndex;
-		qcis[1].queueCount = 1;
-		qcis[1].pQueuePriorities = &queue_priorities;
-		VkDeviceCreateInfo dci{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO};
-		dci.queueCreateInfoCount = graphicsQueueFamilyIndex == presentQueueFamilyIndex ? 1 : 2;
+		std::vector<VkDeviceQueueCreateInfo> qcis;
+		for(uint32_t queueFamilyIndex : {graphicsQueueFamilyIndex, presentQueueFamilyIndex, transferQueueFamilyIndex, computeQueueFamilyIndex}) {
+			if(queueFamilyIndex == INT_MAX || std::any_of(qcis.cbegin(), qcis.cend(), [&](auto& qci) { return qci.queueFamilyIndex == queueFamilyIndex; }))
+				continue;
+			VkDeviceQueueCreateInfo qci{VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO};
+			qci.queueFamilyIndex = queueFamilyIndex;
+			qci.queueCount = 1;
+			qci.pQueuePriorities = &queue_priorities;
+			qcis.push_back(qci);
+		}
+		VkPhysicalDeviceVulkan12Features enabledVulkan12Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES};
+		enabledVulkan12Features.timelineSemaphore = VK_TRUE;
+		enabledVulkan12Features.hostQueryReset = physicalDeviceVulkan12Features.hostQueryReset;
+		VkPhysicalDeviceSynchronization2FeaturesKHR enabledSynchronization2Features{VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR};
+		enabledSynchronization2Features.synchronization2 = VK_TRUE;
+		if(synchronization2)
+			enabledVulkan12Features.pNext = &enabledSynchronization2Features;
+		VkDeviceCreateInfo dci{VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO, &enabledVulkan12Features};
+		dci.queueCreateInfoCount = static_cast<uint32_t>(qcis.size());
 		dci.pQueueCreateInfos = &qcis.front();
-		dci.enabledExtensionCount = 1;
-		auto deviceExtensions = VK_KHR_SWAPCHAIN_EXTENSION_NAME;
-		dci.ppEnabledExtensionNames = &deviceExtensions;
-		VK_ASSERT(vkCreateDevice(physicalDevice, &dci, nullptr, &device));
+		dci.enabledExtensionCount = static_cast<uint32_t>(physicalDeviceExtensions.size());
+		dci.ppEnabledExtensionNames = physicalDeviceExtensions.data();
+		VK_ASSERT(vki.vkCreateDevice(physicalDevice, &dci, allocator, &device));
 		ASSERT(device);
 	}
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkGetDeviceQueue);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkDeviceWaitIdle);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkDestroyDevice);
-	vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsDeviceQueue);
+	VulkanDeviceDispatch vkd = LoadDeviceDispatch(vki.vkGetDeviceProcAddr, device);
+	vkd.vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &graphicsDeviceQueue);
 	ASSERT(graphicsDeviceQueue);
-	vkGetDeviceQueue(device, presentQueueFamilyIndex, 0, &presentDeviceQueue);
+	vkd.vkGetDeviceQueue(device, presentQueueFamilyIndex, 0, &presentDeviceQueue);
 	ASSERT(presentDeviceQueue);
+	if(transferQueueFamilyIndex != INT_MAX)
+		vkd.vkGetDeviceQueue(device, transferQueueFamilyIndex, 0, &transferDeviceQueue);
+	if(computeQueueFamilyIndex != INT_MAX)
+		vkd.vkGetDeviceQueue(device, computeQueueFamilyIndex, 0, &computeDeviceQueue);
+	ASSERT(vkd.vkWaitSemaphores && vkd.vkGetSemaphoreCounterValue);
+	ASSERT(!synchronization2 || vkd.vkCmdPipelineBarrier2KHR);
 
-	//Create swap chain image semaphore
-	VkSemaphore imageAvailableSemaphore;
-	VkSemaphore renderingFinishedSemaphore;
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkCreateSemaphore);
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkDestroySemaphore);
-	{
-		VkSemaphoreCreateInfo sci{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
-		VK_ASSERT(vkCreateSemaphore(device, &sci, nullptr, &imageAvailableSemaphore));
-		VK_ASSERT(vkCreateSemaphore(device, &sci, nullptr, &renderingFinishedSemaphore));
-		ASSERT(imageAvailableSemaphore);
-		ASSERT(renderingFinishedSemaphore);
+	//Dispatch microbenchmark, the same device function called through the loader trampoline and through the device dispatch table
+	if(options.dispatchBenchmark) {
+		VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetDeviceQueue);
+		const int CALLS = 1000000;
+		VkQueue queue;
+
+		auto start = GetTickNanoseconds();
+		for(int i = 0; i < CALLS; ++i)
+			vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &queue);
+		auto trampoline = GetTickNanoseconds() - start;
+
+		start = GetTickNanoseconds();
+		for(int i = 0; i < CALLS; ++i)
+			vkd.vkGetDeviceQueue(device, graphicsQueueFamilyIndex, 0, &queue);
+		auto direct = GetTickNanoseconds() - start;
+
+		TCOUT << TEXT("vkGetDeviceQueue x") << CALLS << TEXT(" - loader trampoline: ") << static_cast<double>(trampoline) / CALLS << TEXT(" ns/call, device dispatch: ") << static_cast<double>(direct) / CALLS << TEXT(" ns/call") << std::endl;
 	}
 
 	//Check Surface Capabilities
 	uint32_t swapChainImageCount = 2;
 	VkSurfaceCapabilitiesKHR surfaceCapabilities;
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetPhysicalDeviceSurfaceCapabilitiesKHR);
-	VK_ASSERT(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCapabilities));
-	ASSERT(surfaceCapabilities.minImageCount <= swapChainImageCount && surfaceCapabilities.maxImageCount >= swapChainImageCount && "surfaceCapabilities.minImageCount / .maxImageCount");
+	VK_ASSERT(vki.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCapabilities));
+	ASSERT(surfaceCapabilities.minImageCount <= swapChainImageCount && (surfaceCapabilities.maxImageCount == 0 || surfaceCapabilities.maxImageCount >= swapChainImageCount) && "surfaceCapabilities.minImageCount / .maxImageCount");
 	ASSERT(surfaceCapabilities.maxImageArrayLayers > 0 && "surfaceCapabilities.maxImageArrayLayers is not > 0");
 	ASSERT((surfaceCapabilities.supportedUsageFlags & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT)) && "surfaceCapabilities.supportedUsageFlags do not include VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT and VK_IMAGE_USAGE_TRANSFER_DST_BIT");
 	ASSERT(surfaceCapabilities.currentTransform & VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR && "surfaceCapabilities.currentTransform flag does not include VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR");
 	ASSERT(surfaceCapabilities.supportedCompositeAlpha & VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR && "surfaceCapabilities.supportedCompositeAlpha flag does not include VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR");
 
 	//Check Supported Surface Formats
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetPhysicalDeviceSurfaceFormatsKHR);
 	uint32_t surfaceFormatCount;
-	VK_ASSERT(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, nullptr));
+	VK_ASSERT(vki.vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, nullptr));
 	ASSERT(surfaceFormatCount > 0);
 	std::vector<VkSurfaceFormatKHR> surfaceFormats(surfaceFormatCount);
-	VK_ASSERT(vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, &surfaceFormats.front()));
+	VK_ASSERT(vki.vkGetPhysicalDeviceSurfaceFormatsKHR(physicalDevice, surface, &surfaceFormatCount, &surfaceFormats.front()));
 	ASSERT(surfaceFormats.cend() != std::find_if(surfaceFormats.cbegin(), surfaceFormats.cend(), [](auto& sf) -> bool { return sf.format == VK_FORMAT_B8G8R8A8_UNORM; }) && "Found no surface format VK_FORMAT_B8G8R8A8_UNORM");
 
 	//Find Supported Present Modes
-	VK_LOAD_FROM_VULKAN_INSTANCE(instance, vkGetPhysicalDeviceSurfacePresentModesKHR);
 	uint32_t presentModeCount;
-	VK_ASSERT(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr));
+	VK_ASSERT(vki.vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, nullptr));
 	ASSERT(presentModeCount > 0);
 	std::vector<VkPresentModeKHR> presentModes(presentModeCount);
-	VK_ASSERT(vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, &presentModes.front()));
-	ASSERT(presentModes.cend() != std::find_if(presentModes.cbegin(), presentModes.cend(), [](auto& pm) -> bool { return pm == VK_PRESENT_MODE_FIFO_KHR; }) && "Found no present mode VK_PRESENT_MODE_FIFO_KHR");
+	VK_ASSERT(vki.vkGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, &presentModes.front()));
+	VkPresentModeKHR presentMode = SelectPresentMode(options.presentPolicy, presentModes);
 
-	//Create swap chain
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkCreateSwapchainKHR);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkDestroySwapchainKHR);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkGetSwapchainImagesKHR);
-	VkSwapchainKHR swapChain;
-	std::vector<VkImage> swapChainImages(swapChainImageCount);
+	//Mailbox needs a spare image to always have one to replace
+	if(presentMode == VK_PRESENT_MODE_MAILBOX_KHR && (surfaceCapabilities.maxImageCount == 0 || surfaceCapabilities.maxImageCount >= 3))
+		swapChainImageCount = 3;
+
+	//Explicit image count, to measure the effect of a deeper swap chain
+	if(options.swapChainImageCount) {
+		if(options.swapChainImageCount < surfaceCapabilities.minImageCount || (surfaceCapabilities.maxImageCount && options.swapChainImageCount > surfaceCapabilities.maxImageCount))
+			Abort(TEXT("-images is outside of the image count range the surface supports"));
+		swapChainImageCount = options.swapChainImageCount;
+	}
+
+	//Create present queue timeline
+	QueueTimeline presentTimeline = CreateQueueTimeline(vkd, device, presentDeviceQueue);
+	QueueTimeline transferTimeline{};
+	if(transferDeviceQueue)
+		transferTimeline = CreateQueueTimeline(vkd, device, transferDeviceQueue);
+	QueueTimeline computeTimeline{};
+	if(computeDeviceQueue)
+		computeTimeline = CreateQueueTimeline(vkd, device, computeDeviceQueue);
+
+	//Create overlay render pass
+	//Draws over the cleared image, the resource tracker moves it in and out of COLOR_ATTACHMENT_OPTIMAL around the pass
+	VkRenderPass overlayRenderPass;
 	{
+		VkAttachmentDescription attachment{};
+		attachment.format = VK_FORMAT_B8G8R8A8_UNORM;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+
+		VkRenderPassCreateInfo rpci{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+		rpci.attachmentCount = 1;
+		rpci.pAttachments = &attachment;
+		rpci.subpassCount = 1;
+		rpci.pSubpasses = &subpass;
+		VK_ASSERT(vkd.vkCreateRenderPass(device, &rpci, allocator, &overlayRenderPass));
+	}
+
+	//Create clear render pass
+	//Compatible with the overlay render pass, so the framebuffers and the overlay pipeline are shared. It clears the
+	//acquired image on load and leaves it ready to present, the frame waits for the image at the attachment stage.
+	VkRenderPass clearRenderPass;
+	{
+		VkAttachmentDescription attachment{};
+		attachment.format = VK_FORMAT_B8G8R8A8_UNORM;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+		VkAttachmentReference colorReference = {0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+		VkSubpassDescription subpass{};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorReference;
+
+		//The transition from UNDEFINED chains from the acquire semaphore, the one to PRESENT_SRC_KHR is followed by the
+		//semaphore the present waits on
+		VkSubpassDependency dependencies[2] = {
+			{VK_SUBPASS_EXTERNAL, 0, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0},
+			{0, VK_SUBPASS_EXTERNAL, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, 0, 0},
+		};
+
+		VkRenderPassCreateInfo rpci{VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO};
+		rpci.attachmentCount = 1;
+		rpci.pAttachments = &attachment;
+		rpci.subpassCount = 1;
+		rpci.pSubpasses = &subpass;
+		rpci.dependencyCount = 2;
+		rpci.pDependencies = dependencies;
+		VK_ASSERT(vkd.vkCreateRenderPass(device, &rpci, allocator, &clearRenderPass));
+	}
+
+	//Create swap chain
+	//The swap chain is rebuilt in place when the surface changes, passing the current one as oldSwapchain.
+	//A retired swap chain is destroyed once the present timeline reaches the value of the last
+	//submission that rendered to it, so recreation never waits for the device to go idle.
+	struct RetiredSwapChain {
+		VkSwapchainKHR swapChain;
+		std::vector<VkImageView> imageViews;
+		std::vector<VkFramebuffer> framebuffers;
+		uint64_t lastTimelineValue;
+	};
+	VkSwapchainKHR swapChain = VK_NULL_HANDLE;
+	VkExtent2D swapChainExtent{};
+	std::vector<VkImage> swapChainImages;
+	std::vector<VkImageView> swapChainImageViews;
+	std::vector<VkFramebuffer> swapChainFramebuffers;
+	std::vector<RetiredSwapChain> retiredSwapChains;
+	uint64_t frameNumber = 0;
+	//Used when the surface lets the swap chain pick its extent, headless surfaces do
+	VkExtent2D requestedExtent = {options.width, options.height};
+	if(options.replayInput)
+		ReplayFrameRecords(replay, 0, [&](CaptureRecordType type, const uint8_t* payload, uint32_t) {
+			if(type == CaptureRecordType::Extent)
+				memcpy(&requestedExtent, payload, sizeof(requestedExtent));
+		});
+	auto destroySwapChain = [&](RetiredSwapChain& retired) {
+		for(auto framebuffer : retired.framebuffers)
+			vkd.vkDestroyFramebuffer(device, framebuffer, allocator);
+		for(auto imageView : retired.imageViews)
+			vkd.vkDestroyImageView(device, imageView, allocator);
+		vkd.vkDestroySwapchainKHR(device, retired.swapChain, allocator);
+	};
+	auto createSwapChain = [&]() -> bool {
+		VK_ASSERT(vki.vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physicalDevice, surface, &surfaceCapabilities));
+		VkExtent2D extent = surfaceCapabilities.currentExtent;
+		if(extent.width == UINT32_MAX)
+			extent = requestedExtent;
+
+		//Minimized, nothing to present to
+		if(extent.width == 0 || extent.height == 0)
+			return false;
+
 		VkSwapchainCreateInfoKHR ci{VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR};
 		ci.surface = surface;
 		ci.minImageCount = swapChainImageCount;
 		ci.imageFormat = VK_FORMAT_B8G8R8A8_UNORM;
 		ci.imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR;
-		ci.imageExtent = {static_cast<uint32_t>(wnd.width), static_cast<uint32_t>(wnd.height)};
+		ci.imageExtent = extent;
 		ci.imageArrayLayers = 1;
 		ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
 		ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		ci.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
 		ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
-		ci.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+		ci.presentMode = presentMode;
 		ci.clipped = VK_TRUE;
-		ci.oldSwapchain = VK_NULL_HANDLE;
-		VK_ASSERT(vkCreateSwapchainKHR(device, &ci, nullptr, &swapChain));
+		ci.oldSwapchain = swapChain;
+		VkSwapchainKHR newSwapChain;
+		VK_ASSERT(vkd.vkCreateSwapchainKHR(device, &ci, allocator, &newSwapChain));
+
+		if(swapChain)
+			retiredSwapChains.push_back({swapChain, std::move(swapChainImageViews), std::move(swapChainFramebuffers), presentTimeline.submitted});
+		swapChain = newSwapChain;
+		swapChainExtent = extent;
 
-		uint32_t swapChainImageCountCheck;
-		VK_ASSERT(vkGetSwapchainImagesKHR(device, swapChain, &swapChainImageCountCheck, nullptr));
-		ASSERT(swapChainImageCount == swapChainImageCountCheck);
+		uint32_t imageCount;
+		VK_ASSERT(vkd.vkGetSwapchainImagesKHR(device, swapChain, &imageCount, nullptr));
+		ASSERT(imageCount >= swapChainImageCount);
+		swapChainImages.resize(imageCount);
+		VK_ASSERT(vkd.vkGetSwapchainImagesKHR(device, swapChain, &imageCount, &swapChainImages.front()));
 
-		VK_ASSERT(vkGetSwapchainImagesKHR(device, swapChain, &swapChainImageCountCheck, &swapChainImages.front()));
+		//Views and framebuffers for the overlay pass
+		swapChainImageViews.assign(imageCount, VK_NULL_HANDLE);
+		swapChainFramebuffers.assign(imageCount, VK_NULL_HANDLE);
+		for(uint32_t i = 0; i < imageCount; ++i) {
+			VkImageViewCreateInfo ivci{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+			ivci.image = swapChainImages[i];
+			ivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			ivci.format = VK_FORMAT_B8G8R8A8_UNORM;
+			ivci.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+			VK_ASSERT(vkd.vkCreateImageView(device, &ivci, allocator, &swapChainImageViews[i]));
+
+			VkFramebufferCreateInfo fci{VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO};
+			fci.renderPass = overlayRenderPass;
+			fci.attachmentCount = 1;
+			fci.pAttachments = &swapChainImageViews[i];
+			fci.width = extent.width;
+			fci.height = extent.height;
+			fci.layers = 1;
+			VK_ASSERT(vkd.vkCreateFramebuffer(device, &fci, allocator, &swapChainFramebuffers[i]));
+		}
+
+		return true;
+	};
+	bool swapChainValid = createSwapChain();
+
+	//Create GPU profiler, disabled when the present queue has no timestamps or host query reset is missing
+	GpuProfiler gpuProfiler = CreateGpuProfiler(vkd, device, options.framesInFlight, physicalDeviceProperties.properties.limits.timestampPeriod, presentQueueTimestampValidBits, physicalDeviceVulkan12Features.hostQueryReset == VK_TRUE);
+	if(calibratedTimestamps && gpuProfiler.enabled) {
+		trace.timestampPeriod = gpuProfiler.timestampPeriod;
+		trace.timestampMask = gpuProfiler.timestampMask;
+		TraceCalibrateGpu(vkd, device);
 	}
 
-	//Create command pool
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkCreateCommandPool);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkDestroyCommandPool);
-	VkCommandPool commandPool;
+	//Queue busy time, compute only counts when it has a queue of its own
+	bool asyncCompute = computeDeviceQueue && options.fill == FillMode::AsyncCompute;
+	QueueBusy graphicsBusy = CreateQueueBusy(vkd, device, options.framesInFlight, physicalDeviceProperties.properties.limits.timestampPeriod, presentQueueTimestampValidBits);
+	QueueBusy computeBusy = CreateQueueBusy(vkd, device, options.framesInFlight, physicalDeviceProperties.properties.limits.timestampPeriod, asyncCompute ? computeQueueTimestampValidBits : 0);
+
+	//Create device memory allocator
+	DeviceAllocator deviceAllocator = CreateDeviceAllocator(vki, physicalDevice, memoryBudget);
+
+	//Device memory microbenchmark, sub-allocations against one vkAllocateMemory per object
+	if(options.allocationBenchmark) {
+		const uint32_t OBJECTS = 100000;
+		//Driver allocation count limits are as low as 4096, leave room for the blocks
+		const uint32_t DEDICATED_OBJECTS = std::min(OBJECTS, physicalDeviceProperties.properties.limits.maxMemoryAllocationCount / 2);
+		std::vector<DeviceAllocation> allocations(OBJECTS);
+		std::vector<VkMemoryRequirements> requirements(OBJECTS);
+		std::vector<uint32_t> order(OBJECTS);
+		uint32_t random = 1;
+		auto nextRandom = [&]() -> uint32_t { random = random * 1664525 + 1013904223; return random >> 8; };
+		for(uint32_t i = 0; i < OBJECTS; ++i) {
+			//64 bytes to 4 KB, the range of small uniform and vertex buffers
+			requirements[i] = {(nextRandom() % 64 + 1) * 64, 256, ~0u};
+			order[i] = i;
+		}
+		for(uint32_t i = OBJECTS - 1; i > 0; --i)
+			std::swap(order[i], order[nextRandom() % (i + 1)]);
+
+		auto start = GetTickNanoseconds();
+		for(uint32_t i = 0; i < OBJECTS; ++i)
+			allocations[i] = DeviceAllocate(vkd, device, deviceAllocator, requirements[i], MemoryUsage::GpuOnly, false);
+		auto allocate = GetTickNanoseconds() - start;
+		TCHAR summary[256];
+		DeviceAllocatorSummary(deviceAllocator, summary, sizeof(summary) / sizeof(summary[0]));
+		start = GetTickNanoseconds();
+		for(uint32_t i = 0; i < OBJECTS; ++i)
+			DeviceFree(vkd, device, deviceAllocator, allocations[order[i]]);
+		auto release = GetTickNanoseconds() - start;
+
+		uint32_t memoryTypeIndex = FindMemoryType(deviceAllocator.memoryProperties, ~0u, MemoryUsage::GpuOnly);
+		std::vector<VkDeviceMemory> memories(DEDICATED_OBJECTS);
+		start = GetTickNanoseconds();
+		for(uint32_t i = 0; i < DEDICATED_OBJECTS; ++i) {
+			VkMemoryAllocateInfo mai{VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO, nullptr, requirements[i].size, memoryTypeIndex};
+			VK_ASSERT(vkd.vkAllocateMemory(device, &mai, allocator, &memories[i]));
+		}
+		auto dedicatedAllocate = GetTickNanoseconds() - start;
+		start = GetTickNanoseconds();
+		for(uint32_t i = 0; i < DEDICATED_OBJECTS; ++i)
+			vkd.vkFreeMemory(device, memories[i], allocator);
+		auto dedicatedRelease = GetTickNanoseconds() - start;
+
+		TCOUT << summary << std::endl;
+		TCOUT << TEXT("Sub-allocator x") << OBJECTS << TEXT(" - allocate: ") << static_cast<double>(allocate) / OBJECTS << TEXT(" ns, free: ") << static_cast<double>(release) / OBJECTS << TEXT(" ns") << std::endl;
+		TCOUT << TEXT("vkAllocateMemory x") << DEDICATED_OBJECTS << TEXT(" - allocate: ") << static_cast<double>(dedicatedAllocate) / DEDICATED_OBJECTS << TEXT(" ns, free: ") << static_cast<double>(dedicatedRelease) / DEDICATED_OBJECTS << TEXT(" ns") << std::endl;
+	}
+
+	//Create upload ring, its copies run on the transfer queue or at the start of each frame
+	uint32_t uploadQueueFamilyIndex = transferDeviceQueue && options.asyncUploads ? transferQueueFamilyIndex : presentQueueFamilyIndex;
+	UploadRing uploadRing = CreateUploadRing(vkd, device, deviceAllocator, physicalDeviceProperties.properties.limits.optimalBufferCopyOffsetAlignment, presentTimeline, presentQueueFamilyIndex, transferTimeline, uploadQueueFamilyIndex);
+
+	//Create shader modules and pipeline cache, every pipeline is created after them
+	ShaderModules shaderModules = CreateShaderModules(vkd, device);
+	PipelineCache pipelineCache = CreatePipelineCache(vkd, device, physicalDeviceProperties.properties, options.pipelineCache);
+	auto pipelines_start = GetTickNanoseconds();
+
+	//Create compute fill on a worker thread, its pipeline compiles while the overlay's does
+	//Its targets are created by the first frame that uses them
+	ComputeFill computeFill{};
+	std::thread computeFillWorker;
+	if(options.fill == FillMode::Compute || options.fill == FillMode::AsyncCompute) {
+		VkPipelineCache workerCache = PipelineCacheCreateWorker(vkd, device, pipelineCache);
+		computeFillWorker = std::thread([&, workerCache]() {
+			TraceSetThreadName(TEXT("Pipeline worker"));
+			computeFill = CreateComputeFill(vkd, device, shaderModules, workerCache, options.framesInFlight, presentQueueFamilyIndex, computeTimeline, asyncCompute ? computeQueueFamilyIndex : presentQueueFamilyIndex);
+		});
+	}
+
+	//Create overlay
+	//Font atlas, uploaded once through the upload ring
+	VkImage overlayAtlas;
+	DeviceAllocation overlayAtlasMemory;
+	VkImageView overlayAtlasView;
+	{
+		VkImageCreateInfo ici{VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO};
+		ici.imageType = VK_IMAGE_TYPE_2D;
+		ici.format = VK_FORMAT_R8_UNORM;
+		ici.extent = {OVERLAY_ATLAS_WIDTH, OVERLAY_ATLAS_HEIGHT, 1};
+		ici.mipLevels = 1;
+		ici.arrayLayers = 1;
+		ici.samples = VK_SAMPLE_COUNT_1_BIT;
+		ici.tiling = VK_IMAGE_TILING_OPTIMAL;
+		ici.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		ici.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		ici.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		VK_ASSERT(vkd.vkCreateImage(device, &ici, allocator, &overlayAtlas));
+
+		VkMemoryRequirements memoryRequirements;
+		vkd.vkGetImageMemoryRequirements(device, overlayAtlas, &memoryRequirements);
+		overlayAtlasMemory = DeviceAllocate(vkd, device, deviceAllocator, memoryRequirements, MemoryUsage::GpuOnly, true);
+		VK_ASSERT(vkd.vkBindImageMemory(device, overlayAtlas, overlayAtlasMemory.memory, overlayAtlasMemory.offset));
+
+		VkImageViewCreateInfo ivci{VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO};
+		ivci.image = overlayAtlas;
+		ivci.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		ivci.format = VK_FORMAT_R8_UNORM;
+		ivci.subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		VK_ASSERT(vkd.vkCreateImageView(device, &ivci, allocator, &overlayAtlasView));
+
+		//Copied by the first frame, before anything samples it
+		std::vector<uint8_t> pixels(OVERLAY_ATLAS_WIDTH * OVERLAY_ATLAS_HEIGHT);
+		OverlayAtlasPixels(pixels.data());
+		UploadImage(vkd, device, uploadRing, overlayAtlas, ici.extent, pixels.data(), pixels.size(), VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT, 0);
+	}
+
+	//Atlas descriptor, the sampler is immutable and baked in the set layout
+	VkSampler overlaySampler;
+	VkDescriptorSetLayout overlaySetLayout;
+	VkDescriptorPool overlayDescriptorPool;
+	VkDescriptorSet overlayDescriptorSet;
+	VkPipelineLayout overlayPipelineLayout;
 	{
-		VkCommandPoolCreateInfo ci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
-		ci.queueFamilyIndex = presentQueueFamilyIndex;
-		VK_ASSERT(vkCreateCommandPool(device, &ci, nullptr, &commandPool));
-		ASSERT(commandPool);
+		VkSamplerCreateInfo sci{VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+		sci.magFilter = VK_FILTER_NEAREST;
+		sci.minFilter = VK_FILTER_NEAREST;
+		sci.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		sci.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sci.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		sci.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		VK_ASSERT(vkd.vkCreateSampler(device, &sci, allocator, &overlaySampler));
+
+		VkDescriptorSetLayoutBinding binding = {0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, &overlaySampler};
+		VkDescriptorSetLayoutCreateInfo dslci{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO};
+		dslci.bindingCount = 1;
+		dslci.pBindings = &binding;
+		VK_ASSERT(vkd.vkCreateDescriptorSetLayout(device, &dslci, allocator, &overlaySetLayout));
+
+		VkDescriptorPoolSize poolSize = {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1};
+		VkDescriptorPoolCreateInfo dpci{VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO};
+		dpci.maxSets = 1;
+		dpci.poolSizeCount = 1;
+		dpci.pPoolSizes = &poolSize;
+		VK_ASSERT(vkd.vkCreateDescriptorPool(device, &dpci, allocator, &overlayDescriptorPool));
+
+		VkDescriptorSetAllocateInfo dsai{VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO};
+		dsai.descriptorPool = overlayDescriptorPool;
+		dsai.descriptorSetCount = 1;
+		dsai.pSetLayouts = &overlaySetLayout;
+		VK_ASSERT(vkd.vkAllocateDescriptorSets(device, &dsai, &overlayDescriptorSet));
+
+		VkDescriptorImageInfo imageInfo = {VK_NULL_HANDLE, overlayAtlasView, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+		VkWriteDescriptorSet write{VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET};
+		write.dstSet = overlayDescriptorSet;
+		write.descriptorCount = 1;
+		write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		write.pImageInfo = &imageInfo;
+		vkd.vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+
+		VkPipelineLayoutCreateInfo plci{VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO};
+		plci.setLayoutCount = 1;
+		plci.pSetLayouts = &overlaySetLayout;
+		VK_ASSERT(vkd.vkCreatePipelineLayout(device, &plci, allocator, &overlayPipelineLayout));
 	}
 
-	//Allocate command buffers
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkAllocateCommandBuffers);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkFreeCommandBuffers);
-	std::vector<VkCommandBuffer> presentQueueCommandBuffers(swapChainImageCount);
+	//Alpha blended glyph pipeline, viewport and scissor are dynamic so it survives swap chain recreation
+	VkPipeline overlayPipeline;
 	{
+		VkPipelineShaderStageCreateInfo stages[2] = {{VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO}, {VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO}};
+		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stages[0].module = shaderModules.modules[SHADER("overlay.vert")];
+		stages[0].pName = "main";
+		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[1].module = shaderModules.modules[SHADER("overlay.frag")];
+		stages[1].pName = "main";
+
+		VkVertexInputBindingDescription vertexBinding = {0, sizeof(OverlayVertex), VK_VERTEX_INPUT_RATE_VERTEX};
+		VkVertexInputAttributeDescription vertexAttributes[3] = {
+			{0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(OverlayVertex, x)},
+			{1, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(OverlayVertex, u)},
+			{2, 0, VK_FORMAT_R8G8B8A8_UNORM, offsetof(OverlayVertex, color)},
+		};
+		VkPipelineVertexInputStateCreateInfo vertexInput{VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO};
+		vertexInput.vertexBindingDescriptionCount = 1;
+		vertexInput.pVertexBindingDescriptions = &vertexBinding;
+		vertexInput.vertexAttributeDescriptionCount = 3;
+		vertexInput.pVertexAttributeDescriptions = vertexAttributes;
+
+		VkPipelineInputAssemblyStateCreateInfo inputAssembly{VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
+		inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+		VkPipelineViewportStateCreateInfo viewport{VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO};
+		viewport.viewportCount = 1;
+		viewport.scissorCount = 1;
+
+		VkPipelineRasterizationStateCreateInfo rasterization{VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO};
+		rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterization.cullMode = VK_CULL_MODE_NONE;
+		rasterization.lineWidth = 1.0f;
+
+		VkPipelineMultisampleStateCreateInfo multisample{VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO};
+		multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState blendAttachment{};
+		blendAttachment.blendEnable = VK_TRUE;
+		blendAttachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+		blendAttachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+		blendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+		blendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+		blendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+		blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo blend{VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO};
+		blend.attachmentCount = 1;
+		blend.pAttachments = &blendAttachment;
+
+		VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+		VkPipelineDynamicStateCreateInfo dynamic{VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO};
+		dynamic.dynamicStateCount = 2;
+		dynamic.pDynamicStates = dynamicStates;
+
+		VkGraphicsPipelineCreateInfo gpci{VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
+		gpci.stageCount = 2;
+		gpci.pStages = stages;
+		gpci.pVertexInputState = &vertexInput;
+		gpci.pInputAssemblyState = &inputAssembly;
+		gpci.pViewportState = &viewport;
+		gpci.pRasterizationState = &rasterization;
+		gpci.pMultisampleState = &multisample;
+		gpci.pColorBlendState = &blend;
+		gpci.pDynamicState = &dynamic;
+		gpci.layout = overlayPipelineLayout;
+		gpci.renderPass = overlayRenderPass;
+		gpci.subpass = 0;
+		VK_ASSERT(vkd.vkCreateGraphicsPipelines(device, pipelineCache.cache, 1, &gpci, allocator, &overlayPipeline));
+	}
+	if(computeFillWorker.joinable())
+		computeFillWorker.join();
+	auto pipelines_time = GetTickNanoseconds() - pipelines_start;
+
+	//Vertex buffer in device local memory, uploaded through the ring when the text or the extent changes
+	VkBuffer overlayVertexBuffer;
+	DeviceAllocation overlayVertexMemory;
+	CreateBuffer(vkd, device, deviceAllocator, sizeof(OverlayVertex) * OVERLAY_MAX_VERTICES, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuOnly, &overlayVertexBuffer, &overlayVertexMemory);
+	std::vector<OverlayVertex> overlayVertices(OVERLAY_MAX_VERTICES);
+	uint32_t overlayVertexCount = 0;
+	VkExtent2D overlayExtent = {};
+	bool overlayTextChanged = true;
+
+	//Scene vertex buffer, uploaded once, its quads do not depend on the extent
+	VkBuffer sceneVertexBuffer = VK_NULL_HANDLE;
+	DeviceAllocation sceneVertexMemory{};
+	if(options.sceneDraws) {
+		VkDeviceSize sceneSize = sizeof(OverlayVertex) * 6 * options.sceneDraws;
+		CreateBuffer(vkd, device, deviceAllocator, sceneSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, MemoryUsage::GpuOnly, &sceneVertexBuffer, &sceneVertexMemory);
+		std::vector<OverlayVertex> sceneVertices(6 * options.sceneDraws);
+		SceneBuild(sceneVertices.data(), options.sceneDraws);
+		UploadBuffer(vkd, device, uploadRing, sceneVertexBuffer, 0, sceneVertices.data(), sceneSize, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, presentTimeline.submitted);
+	}
+
+	//Overlay text, rebuilt with the statistics once per second
+	const size_t OVERLAY_TEXT_SIZE = 2048;
+	TCHAR overlayText[OVERLAY_TEXT_SIZE] = TEXT("");
+
+	//Create frame contexts
+	//Each frame in flight owns its semaphores and command pool, and remembers the present timeline value
+	//of its last submission. The CPU only records into a slot once the timeline has reached that value.
+	struct FrameContext {
+		uint64_t timelineValue;
+		VkSemaphore imageAvailableSemaphore;
+		VkSemaphore renderingFinishedSemaphore;
+		VkCommandPool commandPool;
+		VkCommandBuffer commandBuffer;
+	};
+	std::vector<FrameContext> frames(options.framesInFlight);
+	for(auto& frame : frames) {
+		frame.timelineValue = 0;
+
+		VkSemaphoreCreateInfo sci{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
+		VK_ASSERT(vkd.vkCreateSemaphore(device, &sci, allocator, &frame.imageAvailableSemaphore));
+		VK_ASSERT(vkd.vkCreateSemaphore(device, &sci, allocator, &frame.renderingFinishedSemaphore));
+		ASSERT(frame.imageAvailableSemaphore);
+		ASSERT(frame.renderingFinishedSemaphore);
+
+		VkCommandPoolCreateInfo cpci{VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO};
+		cpci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+		cpci.queueFamilyIndex = presentQueueFamilyIndex;
+		VK_ASSERT(vkd.vkCreateCommandPool(device, &cpci, allocator, &frame.commandPool));
+		ASSERT(frame.commandPool);
+
 		VkCommandBufferAllocateInfo ai{VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO};
-		ai.commandPool = commandPool;
+		ai.commandPool = frame.commandPool;
 		ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-		ai.commandBufferCount = swapChainImageCount;
-		VK_ASSERT(vkAllocateCommandBuffers(device, &ai, &presentQueueCommandBuffers.front()));
+		ai.commandBufferCount = 1;
+		VK_ASSERT(vkd.vkAllocateCommandBuffers(device, &ai, &frame.commandBuffer));
 	}
 
-	//Record command buffers
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkBeginCommandBuffer);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkCmdPipelineBarrier);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkCmdClearColorImage);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkEndCommandBuffer);
-	auto recordCommandBuffer = [&](float red, float green, float blue) {
-		VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
-		VkClearColorValue clearColorValue = {{red, green, blue, 0.0f}};
+	//Command stream capture
+	Capture capture{};
+	if(options.captureOutput)
+		CaptureOpen(capture, options.captureOutput, static_cast<uint64_t>(options.captureRingMegabytes) << 20);
+
+	//Barriers of the frame command buffers, recorded from the tracked state of each resource
+	ResourceTracker resourceTracker = CreateResourceTracker(synchronization2);
+
+	//The acquired image, its contents are discarded and the present engine is done with it at the stage the frame
+	//waits on the acquire semaphore
+	auto acquiredImage = [&](uint32_t imageIndex, VkPipelineStageFlags2KHR imageAvailableStage) -> TrackedImage {
+		TrackedImage image{swapChainImages[imageIndex], {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1}};
+		image.state.layout = VK_IMAGE_LAYOUT_UNDEFINED;
+		image.state.readStages = imageAvailableStage;
+		return image;
+	};
+
+	//Items first to first + count - 1 of the overlay pass: the scene quads, then the text as the last item
+	//Records into commandBuffer only, recorder threads call it for their share of the items
+	auto drawOverlayItems = [&](VkCommandBuffer commandBuffer, uint32_t first, uint32_t count, uint32_t vertexCount) {
+		uint32_t sceneEnd = std::min(first + count, options.sceneDraws);
+		bool text = first + count > options.sceneDraws && vertexCount;
+		if(first >= sceneEnd && !text)
+			return;
+		VkViewport viewport = {0.0f, 0.0f, static_cast<float>(swapChainExtent.width), static_cast<float>(swapChainExtent.height), 0.0f, 1.0f};
+		VkRect2D scissor = {{0, 0}, swapChainExtent};
+		VkDeviceSize vertexOffset = 0;
+		vkd.vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, overlayPipeline);
+		vkd.vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+		vkd.vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+		vkd.vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, overlayPipelineLayout, 0, 1, &overlayDescriptorSet, 0, nullptr);
+		if(first < sceneEnd) {
+			vkd.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &sceneVertexBuffer, &vertexOffset);
+			for(uint32_t i = first; i < sceneEnd; ++i)
+				vkd.vkCmdDraw(commandBuffer, 6, 1, i * 6, 0);
+		}
+		if(text) {
+			vkd.vkCmdBindVertexBuffers(commandBuffer, 0, 1, &overlayVertexBuffer, &vertexOffset);
+			vkd.vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		}
+	};
+
+	//Overlay in renderPass, the overlay render pass over an image in VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL or the
+	//clear render pass, which clears to clearColor
+	//The draws are recorded inline, or run from secondaryCount secondary command buffers when there are any
+	auto drawOverlay = [&](VkCommandBuffer commandBuffer, VkRenderPass renderPass, uint32_t imageIndex, uint32_t vertexCount, const VkClearColorValue& clearColor, uint32_t secondaryCount = 0, const VkCommandBuffer* secondaries = nullptr) {
+		VkClearValue clearValue;
+		clearValue.color = clearColor;
+		VkRenderPassBeginInfo renderPassBeginInfo{VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO};
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.framebuffer = swapChainFramebuffers[imageIndex];
+		renderPassBeginInfo.renderArea = {{0, 0}, swapChainExtent};
+		renderPassBeginInfo.clearValueCount = 1;
+		renderPassBeginInfo.pClearValues = &clearValue;
+
+		if(secondaryCount) {
+			vkd.vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			vkd.vkCmdExecuteCommands(commandBuffer, secondaryCount, secondaries);
+		}
+		else {
+			vkd.vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+			drawOverlayItems(commandBuffer, 0, options.sceneDraws + 1, vertexCount);
+		}
+		vkd.vkCmdEndRenderPass(commandBuffer);
+	};
+
+	//Parallel recording of the overlay pass of recorded frames
+	ParallelRecorder parallelRecorder{};
+	if(options.recordThreads)
+		CreateParallelRecorder(vkd, device, parallelRecorder, options.recordThreads, options.framesInFlight, presentQueueFamilyIndex);
+	std::vector<VkCommandBuffer> overlaySecondaries(options.recordThreads);
+	std::function<void(VkCommandBuffer, uint32_t, uint32_t)> recordOverlayItems = [&](VkCommandBuffer commandBuffer, uint32_t first, uint32_t count) {
+		drawOverlayItems(commandBuffer, first, count, overlayVertexCount);
+	};
+	//The secondaries inherit the overlay render pass, which the clear render pass is compatible with
+	auto recordOverlayPass = [&](VkCommandBuffer commandBuffer, VkRenderPass renderPass, uint32_t imageIndex, uint32_t frameSlot, const VkClearColorValue& clearColor) {
+		if(parallelRecorder.recorders.empty()) {
+			drawOverlay(commandBuffer, renderPass, imageIndex, overlayVertexCount, clearColor);
+			return;
+		}
+		VkCommandBufferInheritanceInfo inheritance{VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+		inheritance.renderPass = overlayRenderPass;
+		inheritance.subpass = 0;
+		inheritance.framebuffer = swapChainFramebuffers[imageIndex];
+		uint32_t secondaryCount = ParallelRecord(parallelRecorder, frameSlot, inheritance, options.sceneDraws + 1, recordOverlayItems, overlaySecondaries.data());
+		drawOverlay(commandBuffer, renderPass, imageIndex, overlayVertexCount, clearColor, secondaryCount, overlaySecondaries.data());
+	};
+
+	//Recording scaling benchmark, the draws of the overlay pass recorded by 1 to N threads into secondaries never submitted
+	//N is -recordthreads when given, the hardware threads otherwise
+	if(options.recordBenchmark) {
+		const uint32_t WARMUP = 20, RUNS = 200;
+		uint32_t maxThreads = options.recordThreads ? options.recordThreads : std::min(std::max(std::thread::hardware_concurrency(), 1u), static_cast<uint32_t>(RECORD_MAX_THREADS));
+		VkCommandBufferInheritanceInfo inheritance{VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+		inheritance.renderPass = overlayRenderPass;
+		std::vector<VkCommandBuffer> secondaries(maxThreads);
+		double oneThread = 0.0;
+
+		TCOUT << TEXT("Record ") << options.sceneDraws << TEXT(" draws into secondary command buffers, average of ") << RUNS << TEXT(" runs") << std::endl;
+		for(uint32_t threads = 1; threads <= maxThreads; ++threads) {
+			ParallelRecorder benchmarkRecorder{};
+			CreateParallelRecorder(vkd, device, benchmarkRecorder, threads, options.framesInFlight, presentQueueFamilyIndex);
+			int64_t elapsed = 0;
+			for(uint32_t run = 0; run < WARMUP + RUNS; ++run) {
+				auto start = GetTickNanoseconds();
+				ParallelRecord(benchmarkRecorder, run % options.framesInFlight, inheritance, options.sceneDraws + 1, recordOverlayItems, secondaries.data());
+				if(run >= WARMUP)
+					elapsed += GetTickNanoseconds() - start;
+			}
+			DestroyParallelRecorder(vkd, device, benchmarkRecorder);
+
+			double milliseconds = elapsed / 1e6 / RUNS;
+			if(threads == 1)
+				oneThread = milliseconds;
+			TCOUT << TEXT("\t") << threads << (threads == 1 ? TEXT(" thread: ") : TEXT(" threads: ")) << milliseconds << TEXT(" ms, ") << oneThread / milliseconds << TEXT("x") << std::endl;
+		}
+	}
+
+	const ResourceUsage overlayUsage = {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+	//Presentation waits on the semaphore the submission signals, nothing else in the queue reads the image
+	const ResourceUsage presentUsage = {VK_PIPELINE_STAGE_2_NONE_KHR, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+	const ResourceUsage clearUsage = {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+	//The clear render pass leaves the image ready to present
+	const ResourceUsage clearOverlayUsage = {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT_KHR | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+	//Stage of the first use of the acquired image, the submission waits on the acquire semaphore there
+	const VkPipelineStageFlags recordImageAvailableStage = options.fill == FillMode::RenderPass ? VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT;
+
+	//Render graph of the frame
+	//The clear is declared in every fill mode, the graph culls it when a fill copy or the clear render pass overwrites
+	//the whole image
+	uint32_t graphImageIndex = 0; //inputs of the passes, set before every execution
+	uint32_t graphFrameSlot = 0;
+	VkClearColorValue graphClearColor = {};
+	RenderGraph renderGraph{};
+	uint32_t graphSwapChainImage = RenderGraphImportImage(renderGraph, TEXT("swap chain"), presentUsage);
+	RenderGraphAddPass(renderGraph, TEXT("clear"), {{graphSwapChainImage, clearUsage, true}}, [&](VkCommandBuffer commandBuffer) {
 		VkImageSubresourceRange imageSubresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
-		VkImageMemoryBarrier barrierFromPresentToClear = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, VK_ACCESS_MEMORY_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, presentQueueFamilyIndex, presentQueueFamilyIndex, 0, imageSubresourceRange};
-		VkImageMemoryBarrier barrierFromClearToPresent = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, presentQueueFamilyIndex, presentQueueFamilyIndex, 0, imageSubresourceRange};
-
-		for(uint32_t i = 0; i < swapChainImageCount; ++i) {
-			barrierFromPresentToClear.image = swapChainImages[i];
-			barrierFromClearToPresent.image = swapChainImages[i];
-			VK_ASSERT(vkBeginCommandBuffer(presentQueueCommandBuffers[i], &commandBufferBeginInfo));
-			vkCmdPipelineBarrier(presentQueueCommandBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrierFromPresentToClear);
-			vkCmdClearColorImage(presentQueueCommandBuffers[i], swapChainImages[i], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColorValue, 1, &imageSubresourceRange);
-			vkCmdPipelineBarrier(presentQueueCommandBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrierFromClearToPresent);
-			VK_ASSERT(vkEndCommandBuffer(presentQueueCommandBuffers[i]));
+		vkd.vkCmdClearColorImage(commandBuffer, RenderGraphGetImage(renderGraph, graphSwapChainImage), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &graphClearColor, 1, &imageSubresourceRange);
+	});
+	uint32_t graphFillTarget = RENDER_GRAPH_NONE;
+	if(computeFill.pipeline) {
+		//Async targets are filled on the compute queue and only imported, in frame ones are transient
+		if(computeFill.async) {
+			graphFillTarget = RenderGraphImportImage(renderGraph, TEXT("fill target"), {});
+		}
+		else {
+			graphFillTarget = RenderGraphCreateImage(renderGraph, TEXT("fill target"), VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+			RenderGraphAddPass(renderGraph, TEXT("fill"), {{graphFillTarget, {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR, VK_IMAGE_LAYOUT_GENERAL}, true}}, [&](VkCommandBuffer commandBuffer) {
+				ComputeFillRecord(vkd, device, computeFill, graphFrameSlot, commandBuffer, RenderGraphGetView(renderGraph, graphFillTarget), swapChainExtent, graphClearColor.float32[0], graphClearColor.float32[1], graphClearColor.float32[2]);
+			});
+		}
+		RenderGraphAddPass(renderGraph, TEXT("fill copy"), {{graphFillTarget, {VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL}}, {graphSwapChainImage, clearUsage, true}}, [&](VkCommandBuffer commandBuffer) {
+			VkImageCopy region{};
+			region.srcSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+			region.dstSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1};
+			region.extent = {swapChainExtent.width, swapChainExtent.height, 1};
+			vkd.vkCmdCopyImage(commandBuffer, RenderGraphGetImage(renderGraph, graphFillTarget), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, RenderGraphGetImage(renderGraph, graphSwapChainImage), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+		});
+	}
+	if(options.fill == FillMode::RenderPass) {
+		RenderGraphAccess clearOverlayAccess{graphSwapChainImage, clearOverlayUsage};
+		clearOverlayAccess.discard = true; //VK_ATTACHMENT_LOAD_OP_CLEAR
+		clearOverlayAccess.renderPass = true; //from UNDEFINED to PRESENT_SRC_KHR
+		RenderGraphAddPass(renderGraph, TEXT("clear + overlay"), {clearOverlayAccess}, [&](VkCommandBuffer commandBuffer) {
+			recordOverlayPass(commandBuffer, clearRenderPass, graphImageIndex, graphFrameSlot, graphClearColor);
+		});
+	}
+	else {
+		RenderGraphAddPass(renderGraph, TEXT("overlay"), {{graphSwapChainImage, overlayUsage}}, [&](VkCommandBuffer commandBuffer) {
+			recordOverlayPass(commandBuffer, overlayRenderPass, graphImageIndex, graphFrameSlot, graphClearColor);
+		});
+	}
+	RenderGraphCompile(renderGraph);
+
+	//Record command buffer
+	//Only the buffer for the acquired image is recorded; the whole pool is reset at once beforehand
+	auto recordCommandBuffer = [&](FrameContext& frame, uint32_t imageIndex, float red, float green, float blue) {
+		VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
+		TrackedImage trackedImage = acquiredImage(imageIndex, recordImageAvailableStage);
+		uint32_t frameSlot = static_cast<uint32_t>(&frame - frames.data());
+
+		if(overlayTextChanged || overlayExtent.width != swapChainExtent.width || overlayExtent.height != swapChainExtent.height) {
+			overlayVertexCount = OverlayBuild(overlayVertices.data(), swapChainExtent, overlayText);
+			overlayExtent = swapChainExtent;
+			overlayTextChanged = false;
+			if(overlayVertexCount)
+				UploadBuffer(vkd, device, uploadRing, overlayVertexBuffer, 0, overlayVertices.data(), sizeof(OverlayVertex) * overlayVertexCount, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, presentTimeline.submitted);
+		}
+
+		VK_ASSERT(vkd.vkResetCommandPool(device, frame.commandPool, 0));
+		VK_ASSERT(vkd.vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+		QueueBusyBegin(vkd, graphicsBusy, commandBuffer, frameSlot);
+		auto zone = GpuZoneBegin(vkd, gpuProfiler, commandBuffer, TEXT("upload"));
+		UploadRecord(vkd, device, uploadRing, commandBuffer);
+		GpuZoneEnd(vkd, gpuProfiler, commandBuffer, zone);
+		//The frames in flight still use the transient images of the previous extent
+		if(renderGraph.extent.width != swapChainExtent.width || renderGraph.extent.height != swapChainExtent.height)
+			RenderGraphResize(vkd, device, deviceAllocator, renderGraph, swapChainExtent, presentTimeline.submitted);
+		graphImageIndex = imageIndex;
+		graphFrameSlot = frameSlot;
+		graphClearColor = {{red, green, blue, 0.0f}};
+		RenderGraphImport(renderGraph, graphSwapChainImage, trackedImage);
+		if(computeFill.async)
+			RenderGraphImport(renderGraph, graphFillTarget, ComputeFillSubmit(vkd, device, deviceAllocator, computeFill, resourceTracker, computeBusy, frameSlot, swapChainExtent, red, green, blue));
+		RenderGraphExecute(vkd, renderGraph, resourceTracker, gpuProfiler, commandBuffer);
+		QueueBusyEnd(vkd, graphicsBusy, commandBuffer, frameSlot);
+		VK_ASSERT(vkd.vkEndCommandBuffer(commandBuffer));
+
+		//The fill is captured as the clear it is equivalent to, behind the barrier a clear of the acquired image gets
+		if(capture.enabled) {
+			TrackedImage clearedImage = acquiredImage(imageIndex, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR);
+			VkPipelineStageFlags2KHR srcStages;
+			VkAccessFlags2KHR srcAccess;
+			ResourceTransition(clearedImage.state, clearUsage, &srcStages, &srcAccess);
+			CaptureImageBarrier captureBarrier = {static_cast<VkPipelineStageFlags>(srcStages), VK_PIPELINE_STAGE_TRANSFER_BIT, static_cast<VkAccessFlags>(srcAccess), VK_ACCESS_TRANSFER_WRITE_BIT, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+			CaptureWrite(capture, CaptureRecordType::ImageBarrier, &captureBarrier, sizeof(captureBarrier));
+			CaptureWrite(capture, CaptureRecordType::ClearColorImage, &graphClearColor, sizeof(graphClearColor));
+			CaptureOverlayDraw(capture, overlayVertices.data(), overlayVertexCount);
 		}
 	};
 
+	//Replay command buffer
+	//Re-executes the commands of a captured frame on the acquired image, returns the stage the submission waits for it at
+	const uint8_t* replayOverlayVertices = nullptr;
+	uint32_t replayOverlayVertexCount = 0;
+	auto replayCommandBuffer = [&](FrameContext& frame, uint32_t imageIndex, size_t replayFrame) -> VkPipelineStageFlags {
+		VkCommandBufferBeginInfo commandBufferBeginInfo = {VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, nullptr, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT, nullptr};
+		VkImageSubresourceRange imageSubresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1};
+		VkCommandBuffer commandBuffer = frame.commandBuffer;
+		VkImage image = swapChainImages[imageIndex];
+		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		TrackedImage trackedImage = acquiredImage(imageIndex, waitStage);
+		uint32_t frameSlot = static_cast<uint32_t>(&frame - frames.data());
+
+		VK_ASSERT(vkd.vkResetCommandPool(device, frame.commandPool, 0));
+		VK_ASSERT(vkd.vkBeginCommandBuffer(commandBuffer, &commandBufferBeginInfo));
+		QueueBusyBegin(vkd, graphicsBusy, commandBuffer, frameSlot);
+		auto zone = GpuZoneBegin(vkd, gpuProfiler, commandBuffer, TEXT("replay"));
+		UploadRecord(vkd, device, uploadRing, commandBuffer);
+		ReplayFrameRecords(replay, replayFrame, [&](CaptureRecordType type, const uint8_t* payload, uint32_t) {
+			switch(type) {
+				case CaptureRecordType::ImageBarrier: {
+					CaptureImageBarrier captureBarrier;
+					memcpy(&captureBarrier, payload, sizeof(captureBarrier));
+					VkImageMemoryBarrier barrier = {VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER, nullptr, captureBarrier.srcAccessMask, captureBarrier.dstAccessMask, captureBarrier.oldLayout, captureBarrier.newLayout, presentQueueFamilyIndex, presentQueueFamilyIndex, image, imageSubresourceRange};
+					vkd.vkCmdPipelineBarrier(commandBuffer, captureBarrier.srcStageMask, captureBarrier.dstStageMask, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+					//Recorded as captured, the tracker only takes over after it
+					TrackImageAssume(trackedImage, {captureBarrier.dstStageMask, captureBarrier.dstAccessMask, captureBarrier.newLayout});
+					break;
+				}
+				case CaptureRecordType::ClearColorImage: {
+					VkClearColorValue clearColorValue;
+					memcpy(&clearColorValue, payload, sizeof(clearColorValue));
+					vkd.vkCmdClearColorImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &clearColorValue, 1, &imageSubresourceRange);
+					break;
+				}
+				case CaptureRecordType::OverlayVertices:
+					memcpy(&replayOverlayVertexCount, payload, sizeof(replayOverlayVertexCount));
+					replayOverlayVertices = payload + sizeof(uint32_t);
+					if(replayOverlayVertexCount)
+						UploadBuffer(vkd, device, uploadRing, overlayVertexBuffer, 0, replayOverlayVertices, sizeof(OverlayVertex) * replayOverlayVertexCount, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, presentTimeline.submitted);
+					break;
+				case CaptureRecordType::OverlayDraw: {
+					uint32_t vertexCount;
+					memcpy(&vertexCount, payload, sizeof(vertexCount));
+					if(vertexCount != replayOverlayVertexCount)
+						Abort(TEXT("The capture file draws overlay vertices it does not contain"));
+					UploadRecord(vkd, device, uploadRing, commandBuffer);
+					TrackImage(resourceTracker, trackedImage, overlayUsage);
+					ResourceFlush(vkd, resourceTracker, commandBuffer);
+					drawOverlay(commandBuffer, overlayRenderPass, imageIndex, vertexCount, {});
+					TrackImage(resourceTracker, trackedImage, presentUsage);
+					ResourceFlush(vkd, resourceTracker, commandBuffer);
+					break;
+				}
+				case CaptureRecordType::Submit:
+					memcpy(&waitStage, payload, sizeof(waitStage));
+					break;
+				default:
+					break;
+			}
+		});
+		GpuZoneEnd(vkd, gpuProfiler, commandBuffer, zone);
+		QueueBusyEnd(vkd, graphicsBusy, commandBuffer, frameSlot);
+		VK_ASSERT(vkd.vkEndCommandBuffer(commandBuffer));
+		return waitStage;
+	};
+
 	//Loop Window
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkAcquireNextImageKHR);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkQueueSubmit);
-	VK_LOAD_FROM_VULKAN_DEVICE(device, vkQueuePresentKHR);
 
-	//FPS
+	//FPS, averaged over the last second
 	int fps_accum = 0;
-	int fps = 0;
-	auto tick_prev = GetTick();
+	float fps = 0.0f;
+	auto tick_prev = GetTickNanoseconds();
+
+	//Frame timings, the distribution shows the stutter an average hides
+	static FrameStats frameStats; //static, the histograms are too large for the stack
+	int64_t frame_prev = 0;
+	uint32_t frameIndex = 0;
+	std::basic_string<TCHAR> windowTitle;
+
+	//Queue busy time, per second
+	auto busy_prev = GetTickNanoseconds();
+
+	//Driver host allocations, churn per second
+	uint64_t host_allocations_prev = allocator ? HostAllocatorAllocations() : 0;
+
+	bool startup_reported = false;
+
+	//Swap chain recreation cost
+	int recreate_count = 0;
+	int64_t recreate_max = 0;
+	auto recreateSwapChain = [&]() {
+		auto recreate_start = GetTickNanoseconds();
+		swapChainValid = createSwapChain();
+		recreate_max = std::max(recreate_max, GetTickNanoseconds() - recreate_start);
+		++recreate_count;
+	};
 
 	//Color changing over frames
 	struct ColorCycle {
 		float c, cv;
 	} cv[3] = {{0.2f, 0.008f}, {0.5f, 0.01f}, {0.8f, 0.012f}};
 
-	WndShow(wnd);
-	while(WndLoop()) {
+	//Replay defaults to one pass over the capture, and loops over it when asked for more frames
+	uint64_t frameCount = options.frameCount;
+	if(options.replayInput && !frameCount)
+		frameCount = replay.frames.size();
+	size_t replayFrame = 0;
+
+	auto running = [&]() -> bool {
+		if(frameCount && frameNumber >= options.warmupFrames + frameCount)
+			return false;
+		return options.headless || WndLoop(wnd);
+	};
+	bool measuring = options.warmupFrames == 0;
+	auto measure_start = GetTickNanoseconds();
+
+	if(!options.headless)
+		WndShow(wnd);
+	while(running()) {
+		//Statistics only cover the frames after the warmup
+		if(!measuring && frameNumber >= options.warmupFrames) {
+			FrameStatsReset(frameStats);
+			GpuProfilerResetTotals(gpuProfiler);
+			measure_start = GetTickNanoseconds();
+			measuring = true;
+		}
+
+		//Resize stress test, the client area changes size every frame
+		//Sweeps up from 256x192 below the requested size, from 8x6 when it is smaller than that
+		if(options.resizeStress) {
+			auto step = static_cast<int>(frameNumber % 64);
+			auto width = static_cast<int>(std::max(options.width, 264u)) - 256, height = static_cast<int>(std::max(options.height, 198u)) - 192;
+			WndResize(wnd, width + step * 8, height + step * 6);
+		}
+
+		//Replay follows the extent changes of the capture
+		if(options.replayInput) {
+			ReplayFrameRecords(replay, replayFrame, [&](CaptureRecordType type, const uint8_t* payload, uint32_t) {
+				if(type == CaptureRecordType::Extent)
+					memcpy(&requestedExtent, payload, sizeof(requestedExtent));
+			});
+			if(requestedExtent.width != swapChainExtent.width || requestedExtent.height != swapChainExtent.height)
+				recreateSwapChain();
+		}
+
+		if(WndResized() || !swapChainValid) {
+			recreateSwapChain();
+			if(!swapChainValid) {
+				WndWait(wnd);
+				continue;
+			}
+		}
+
 		//Color changing over frames
-		auto cu = [](float& c, float& cv) -> float { c += cv; if(c < 0.0f) { c = 0.0f; cv = -cv; } if(c > 1.0f) { c = 1.0f; cv = -cv; } return cv; };
-		for(auto& it : cv)
-			cu(it.c, it.cv);
-		recordCommandBuffer(cv[0].c, cv[1].c, cv[2].c);
+		{
+			TraceZone zone(TEXT("color update"));
+			auto cu = [](float& c, float& cv) -> float { c += cv; if(c < 0.0f) { c = 0.0f; cv = -cv; } if(c > 1.0f) { c = 1.0f; cv = -cv; } return cv; };
+			for(auto& it : cv)
+				cu(it.c, it.cv);
+		}
+
+		//Wait until the GPU is done with this frame context
+		auto& frame = frames[frameIndex];
+		{
+			auto wait_start = GetTickNanoseconds();
+			TimelineWaitValue(vkd, device, presentTimeline, frame.timelineValue);
+			auto wait_end = GetTickNanoseconds();
+			HistogramRecord(frameStats.frameWait, wait_end - wait_start);
+			TraceRecord(TEXT("frame wait"), wait_start, wait_end);
+		}
+		GpuProfilerBeginFrame(vkd, device, gpuProfiler, frameIndex);
+		QueueBusyCollect(vkd, device, graphicsBusy, frameIndex);
+		QueueBusyCollect(vkd, device, computeBusy, frameIndex);
+		TraceGpuFrame(gpuProfiler);
+
+		//Release the swap chains no pending submission renders to anymore
+		while(!retiredSwapChains.empty() && TimelineReached(vkd, device, presentTimeline, retiredSwapChains.front().lastTimelineValue)) {
+			destroySwapChain(retiredSwapChains.front());
+			retiredSwapChains.erase(retiredSwapChains.begin());
+		}
+		RenderGraphCollect(vkd, device, deviceAllocator, renderGraph, presentTimeline.completed);
 
 		//Acquire image from swap chain
 		uint32_t imageIndex;
-		VkResult vkAcquireNextImageResult = vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
-		ASSERT(vkAcquireNextImageResult != VK_SUBOPTIMAL_KHR);
-		ASSERT(vkAcquireNextImageResult == VK_SUCCESS);
+		auto acquire_start = GetTickNanoseconds();
+		VkResult vkAcquireNextImageResult = vkd.vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, frame.imageAvailableSemaphore, VK_NULL_HANDLE, &imageIndex);
+		auto acquire_end = GetTickNanoseconds();
+		if(vkAcquireNextImageResult == VK_ERROR_OUT_OF_DATE_KHR) {
+			recreateSwapChain();
+			continue;
+		}
+		else if(vkAcquireNextImageResult != VK_SUCCESS && vkAcquireNextImageResult != VK_SUBOPTIMAL_KHR)
+			VkAbort(vkAcquireNextImageResult, TEXT("vkAcquireNextImageKHR failed"));
+		TraceRecord(TEXT("vkAcquireNextImageKHR"), acquire_start, acquire_end);
+		HistogramRecord(frameStats.acquire, acquire_end - acquire_start);
+		//Frame time is measured between acquires, the first frame has no predecessor
+		if(frame_prev)
+			HistogramRecord(frameStats.frameTime, acquire_end - frame_prev);
+		frame_prev = acquire_end;
+		frameIndex = (frameIndex + 1) % options.framesInFlight;
+		CaptureBeginFrame(capture, frameNumber, imageIndex, swapChainExtent);
+
+		VkPipelineStageFlags imageAvailableStage = recordImageAvailableStage;
+		{
+			auto record_start = GetTickNanoseconds();
+			if(options.replayInput)
+				imageAvailableStage = replayCommandBuffer(frame, imageIndex, replayFrame);
+			else
+				recordCommandBuffer(frame, imageIndex, cv[0].c, cv[1].c, cv[2].c);
+			auto record_end = GetTickNanoseconds();
+			HistogramRecord(frameStats.record, record_end - record_start);
+			TraceRecord(options.replayInput ? TEXT("replay") : TEXT("record"), record_start, record_end);
+		}
 
 		//Submit queue
 		{
-			VkPipelineStageFlags pipelineStageFlags = VK_PIPELINE_STAGE_TRANSFER_BIT;
-			VkSubmitInfo submitInfo = {VK_STRUCTURE_TYPE_SUBMIT_INFO, nullptr, 1, &imageAvailableSemaphore, &pipelineStageFlags, 1, &presentQueueCommandBuffers[imageIndex], 1, &renderingFinishedSemaphore};
-			VK_ASSERT(vkQueueSubmit(presentDeviceQueue, 1, &submitInfo, VK_NULL_HANDLE));
+			TimelineWait waits[3] = {{frame.imageAvailableSemaphore, 0, imageAvailableStage}};
+			uint32_t waitCount = 1;
+			waitCount += UploadWait(uploadRing, &waits[waitCount]);
+			waitCount += ComputeFillWait(computeFill, &waits[waitCount]);
+			auto submit_start = GetTickNanoseconds();
+			frame.timelineValue = TimelineSubmit(vkd, presentTimeline, frame.commandBuffer, waitCount, waits, frame.renderingFinishedSemaphore);
+			UploadSubmitted(uploadRing, frame.timelineValue);
+			auto submit_end = GetTickNanoseconds();
+			HistogramRecord(frameStats.submit, submit_end - submit_start);
+			TraceRecord(TEXT("vkQueueSubmit"), submit_start, submit_end);
+			//Captured frames replay as a transfer clear, which waits for the image at the transfer stage
+			VkPipelineStageFlags capturedStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			CaptureWrite(capture, CaptureRecordType::Submit, &capturedStage, sizeof(capturedStage));
+			++frameNumber;
 		}
 
 		//Present queue
 		{
-			VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, nullptr, 1, &renderingFinishedSemaphore, 1, &swapChain, &imageIndex, nullptr};
-			VK_ASSERT(vkQueuePresentKHR(presentDeviceQueue, &presentInfo));
+			VkPresentInfoKHR presentInfo = {VK_STRUCTURE_TYPE_PRESENT_INFO_KHR, nullptr, 1, &frame.renderingFinishedSemaphore, 1, &swapChain, &imageIndex, nullptr};
+			auto present_start = GetTickNanoseconds();
+			VkResult vkQueuePresentResult = vkd.vkQueuePresentKHR(presentDeviceQueue, &presentInfo);
+			auto present_end = GetTickNanoseconds();
+			HistogramRecord(frameStats.present, present_end - present_start);
+			TraceRecord(TEXT("vkQueuePresentKHR"), present_start, present_end);
+			CaptureWrite(capture, CaptureRecordType::Present, nullptr, 0);
+			CaptureEndFrame(capture);
+			if(vkQueuePresentResult == VK_ERROR_OUT_OF_DATE_KHR || vkQueuePresentResult == VK_SUBOPTIMAL_KHR || vkAcquireNextImageResult == VK_SUBOPTIMAL_KHR)
+				recreateSwapChain();
+			else if(vkQueuePresentResult != VK_SUCCESS)
+				VkAbort(vkQueuePresentResult, TEXT("vkQueuePresentKHR failed"));
+		}
+		if(options.replayInput)
+			replayFrame = (replayFrame + 1) % replay.frames.size();
+
+		//Startup ends with the first present
+		if(frameNumber == 1 && !startup_reported) {
+			startup_reported = true;
+			TCOUT << TEXT("Startup: ") << (GetTickNanoseconds() - startup_start) / 1e6 << TEXT(" ms to the first present, pipelines ") << pipelines_time / 1e6 << TEXT(" ms with a ")
+			      << (pipelineCache.loadedBytes ? TEXT("warm") : TEXT("cold")) << TEXT(" cache (") << pipelineCache.loadedBytes / 1024.0 << TEXT(" KB)") << std::endl;
 		}
 
 		//Calculate FPS
 		++fps_accum;
+		bool fps_updated = false;
 		{
-			auto now = GetTick();
+			auto now = GetTickNanoseconds();
 			auto tick = now - tick_prev;
-			if(tick >= 1000) {
+			if(tick >= 1000000000) {
 				tick_prev = now;
-				fps = fps_accum;
+				fps_updated = true;
+				fps = fps_accum * 1e9f / tick;
 				fps_accum = 0;
 			}
 		}
 
-		//Show FPS
-		{
-			const size_t BUFFER_SIZE = sizeof(TEXT(APPLICATION_NAME)) + 64;
-			TCHAR buffer[BUFFER_SIZE];
-			auto cchText = _stprintf_s(buffer, BUFFER_SIZE, TEXT(APPLICATION_NAME " - FPS: %d"), fps);
-			ASSERT(cchText != -1);
-			SetWindowText(wnd.hWnd, buffer);
+		//Show statistics, the values only change once per second
+		if(fps_updated) {
+			if(trace.gpuCalibrated)
+				TraceCalibrateGpu(vkd, device);
+			auto length = _stprintf_s(overlayText, OVERLAY_TEXT_SIZE, TEXT("FPS: %.1f - %s - Frames in flight: %u\n"), fps, GetPresentModeName(presentMode), options.framesInFlight);
+			ASSERT(length != -1);
+			length += FrameStatsSummary(frameStats, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("Recreate: %d, max %.3f ms\n"), recreate_count, recreate_max / 1e6);
+			if(allocator) {
+				auto host_allocations = HostAllocatorAllocations();
+				length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("Host allocations: %llu in the last second\n"), static_cast<unsigned long long>(host_allocations - host_allocations_prev));
+				host_allocations_prev = host_allocations;
+			}
+			DeviceAllocatorUpdateBudget(vki, physicalDevice, deviceAllocator);
+			length += DeviceAllocatorSummary(deviceAllocator, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("\n"));
+			length += UploadRingSummary(uploadRing, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("\n"));
+			length += ResourceTrackerSummary(resourceTracker, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("\n"));
+			length += RenderGraphSummary(renderGraph, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			if(!parallelRecorder.recorders.empty()) {
+				length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("\n"));
+				length += ParallelRecorderSummary(parallelRecorder, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			}
+			auto busy_now = GetTickNanoseconds();
+			length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("\n"));
+			length += QueueBusySummary(graphicsBusy, computeBusy, (busy_now - busy_prev) / 1e9, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			busy_prev = busy_now;
+			length += _stprintf_s(overlayText + length, OVERLAY_TEXT_SIZE - length, TEXT("\nGPU ms: "));
+			GpuProfilerAverages(gpuProfiler, overlayText + length, OVERLAY_TEXT_SIZE - length);
+			overlayTextChanged = true;
+			if(options.headless)
+				TCOUT << overlayText << std::endl;
+			else {
+				//The title bar is a window system round trip, only update it when its text changes
+				const size_t TITLE_SIZE = sizeof(TEXT(APPLICATION_NAME)) + 64;
+				TCHAR title[TITLE_SIZE];
+				_stprintf_s(title, TITLE_SIZE, TEXT(APPLICATION_NAME " - FPS: %.0f - %s"), fps, GetPresentModeName(presentMode));
+				if(windowTitle != title) {
+					windowTitle = title;
+					WndSetTitle(wnd, title);
+				}
+			}
 		}
 	}
 
+	auto measure_seconds = (GetTickNanoseconds() - measure_start) / 1e9;
+	CaptureClose(capture);
+	uint64_t measuredFrames = measuring ? frameNumber - options.warmupFrames : 0;
+	if(options.headless)
+		TCOUT << TEXT("Frames: ") << measuredFrames << TEXT(", seconds: ") << measure_seconds << TEXT(", average FPS: ") << (measure_seconds > 0.0 ? measuredFrames / measure_seconds : 0.0) << std::endl;
+	{
+		TCHAR buffer[1024];
+		FrameStatsSummary(frameStats, buffer, sizeof(buffer) / sizeof(buffer[0]));
+		TCOUT << buffer;
+	}
+
+	int exitCode = 0;
+	if(options.benchmarkOutput) {
+		BenchmarkReport report{};
+		report.deviceName = physicalDeviceProperties.properties.deviceName;
+		report.width = swapChainExtent.width;
+		report.height = swapChainExtent.height;
+		report.presentModeName = GetPresentModeName(presentMode);
+		report.fillModeName = GetFillModeName(options.fill);
+		report.sceneDraws = options.sceneDraws;
+		report.recordThreads = options.recordThreads;
+		report.swapChainImageCount = static_cast<uint32_t>(swapChainImages.size());
+		report.framesInFlight = options.framesInFlight;
+		report.warmupFrames = options.warmupFrames;
+		report.measuredFrames = measuredFrames;
+		report.seconds = measure_seconds;
+		report.peakMemoryBytes = GetPeakMemoryBytes();
+		report.frameStats = &frameStats;
+		report.gpuProfiler = &gpuProfiler;
+		WriteBenchmarkReport(report, options.benchmarkOutput);
+		if(options.benchmarkBaseline && !CompareBenchmarkBaseline(report, options.benchmarkBaseline, options.regressionThreshold))
+			exitCode = 2;
+	}
+
 	//Destroy
-	VK_ASSERT(vkDeviceWaitIdle(device));
-	vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(presentQueueCommandBuffers.size()), &presentQueueCommandBuffers.front());
-	vkDestroyCommandPool(device, commandPool, nullptr);
-	vkDestroySemaphore(device, renderingFinishedSemaphore, nullptr);
-	vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
-	vkDestroyDevice(device, nullptr);
-	vkDestroyInstance(instance, nullptr);
+	VK_ASSERT(vkd.vkDeviceWaitIdle(device));
+	PipelineCacheSave(vkd, device, pipelineCache);
+	DestroyPipelineCache(vkd, device, pipelineCache);
+	DestroyShaderModules(vkd, device, shaderModules);
+	for(auto& frame : frames) {
+		vkd.vkFreeCommandBuffers(device, frame.commandPool, 1, &frame.commandBuffer);
+		vkd.vkDestroyCommandPool(device, frame.commandPool, allocator);
+		vkd.vkDestroySemaphore(device, frame.renderingFinishedSemaphore, allocator);
+		vkd.vkDestroySemaphore(device, frame.imageAvailableSemaphore, allocator);
+	}
+	DestroyGpuProfiler(vkd, device, gpuProfiler);
+	DestroyQueueBusy(vkd, device, graphicsBusy);
+	DestroyQueueBusy(vkd, device, computeBusy);
+	DestroyQueueTimeline(vkd, device, presentTimeline);
+	if(transferTimeline.semaphore)
+		DestroyQueueTimeline(vkd, device, transferTimeline);
+	if(computeTimeline.semaphore)
+		DestroyQueueTimeline(vkd, device, computeTimeline);
+	DestroyRenderGraph(vkd, device, deviceAllocator, renderGraph);
+	if(!parallelRecorder.recorders.empty())
+		DestroyParallelRecorder(vkd, device, parallelRecorder);
+	//Every thread that records zones has joined
+	if(options.traceOutput)
+		TraceStop(options.traceOutput);
+	if(computeFill.pipeline)
+		DestroyComputeFill(vkd, device, deviceAllocator, computeFill);
+	DestroyBuffer(vkd, device, deviceAllocator, overlayVertexBuffer, overlayVertexMemory);
+	if(sceneVertexBuffer)
+		DestroyBuffer(vkd, device, deviceAllocator, sceneVertexBuffer, sceneVertexMemory);
+	vkd.vkDestroyPipeline(device, overlayPipeline, allocator);
+	vkd.vkDestroyPipelineLayout(device, overlayPipelineLayout, allocator);
+	vkd.vkDestroyDescriptorPool(device, overlayDescriptorPool, allocator);
+	vkd.vkDestroyDescriptorSetLayout(device, overlaySetLayout, allocator);
+	vkd.vkDestroySampler(device, overlaySampler, allocator);
+	vkd.vkDestroyImageView(device, overlayAtlasView, allocator);
+	vkd.vkDestroyImage(device, overlayAtlas, allocator);
+	DeviceFree(vkd, device, deviceAllocator, overlayAtlasMemory);
+	for(auto& retired : retiredSwapChains)
+		destroySwapChain(retired);
+	{
+		RetiredSwapChain current = {swapChain, std::move(swapChainImageViews), std::move(swapChainFramebuffers), 0};
+		destroySwapChain(current);
+	}
+	vkd.vkDestroyRenderPass(device, clearRenderPass, allocator);
+	vkd.vkDestroyRenderPass(device, overlayRenderPass, allocator);
+	DestroyUploadRing(vkd, device, deviceAllocator, uploadRing);
+	DestroyDeviceAllocator(vkd, device, deviceAllocator);
+	vkd.vkDestroyDevice(device, allocator);
+	vki.vkDestroySurfaceKHR(instance, surface, allocator);
+	vki.vkDestroyInstance(instance, allocator);
+
+	//Live allocations left here were not freed by the driver
+	if(allocator) {
+		TCHAR buffer[1024];
+		HostAllocatorSummary(buffer, sizeof(buffer) / sizeof(buffer[0]));
+		TCOUT << TEXT("Host allocations by scope:\n") << buffer;
+	}
+#ifdef _WIN32
 	WIN32_ASSERT(FreeLibrary(vulkan));
+#else
+	if(!options.headless) {
+		xcb_destroy_window(wnd.connection, wnd.window);
+		xcb_disconnect(wnd.connection);
+	}
+	if(dlclose(vulkan))
+		DlAbort(TEXT("dlclose failed"));
+#endif
+
+	return exitCode;
 };
 
+#ifdef _WIN32
 int WINAPI WinMain(_In_ HINSTANCE, _In_opt_ HINSTANCE, _In_ LPSTR, _In_ INT)
 {
-	OneFileVulkan();
-	return 0;
+	return OneFileVulkan(ParseOptions(__argc, __argv));
 }
+#else
+int main(int argc, char** argv)
+{
+	return OneFileVulkan(ParseOptions(argc, argv));
+}
+#endif